@@ -6,7 +6,17 @@
 #include <stdexcept>
 #include <vector>
 #include <unordered_set>
-#include "utils.h"
+#include <algorithm>
+#include <iterator>
+#include <cstdint>
+#include "FrameArena.h"
+#include "CollisionPair.h"
+#include "SimdKernels.h"
+#include "SpatialIndex.h"
+#include "JobSystem.h"
+#include "PairSink.h"
+#include "StepStats.h"
+#include "Tracer.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
@@ -21,136 +31,123 @@ struct Point {
     }
 }; 
 
+// Fixed capacity simplex for GJK, it never holds more than 4 points so it doesn't need the heap
+struct Simplex {
+    glm::vec3 points[4];
+    int count = 0;
+
+    size_t size() const { return count; }
+    void push_back(const glm::vec3 &p) { points[count++] = p; }
+    glm::vec3& operator[](int i) { return points[i]; }
+    glm::vec3& front() { return points[0]; }
+    glm::vec3& back() { return points[count - 1]; }
+    const glm::vec3* begin() const { return points; }
+    const glm::vec3* end() const { return points + count; }
+
+    // Remove the point at the given position, keeping the order of the others
+    void erase(int index) {
+        for (int i = index; i < count - 1; i++)
+            points[i] = points[i + 1];
+        count--;
+    }
+};
+
 class CollisionDetection
 {
 public:
     // Constructor
-    CollisionDetection(SphereBV* spheres, int numSpheres, float WorldSize, std::vector<std::pair<SphereBV*, SphereBV*>>* collisionPairs, int method = 0)
-        : spheres(spheres), numSpheres(numSpheres), worldSize(WorldSize), collisionPairs(collisionPairs), method(method) {
-        collisionPairs->clear();
+    // The object is meant to live as long as the world. Its temporaries (endpoints, candidate pairs,
+    // collision pairs) are taken from the frame arenas given to beginStep(), so a step does no heap allocation.
+    // With a JobSystem the phases run on its workers, every worker allocating from its own arena of the pool.
+    CollisionDetection(SphereStore* spheres, float WorldSize, int method = 0)
+        : spheres(spheres), numSpheres(spheres->size()), worldSize(WorldSize), method(method),
+          keepIndex(false), arenas(nullptr), jobs(nullptr), arena(nullptr), firstAxisArena(0), lastGjkIterations(0) {
     }
 
+    CollisionDetection(const CollisionDetection&) = delete;
+    CollisionDetection& operator=(const CollisionDetection&) = delete;
+
     // Destructor - Modified to not delete spheres, since it doesn't own them
     ~CollisionDetection() {
         // Remove the delete[] spheres line since this class doesn't own the memory
     }
 
-    // Broad Collision Detection
-    void broadCollisionDetection(){
-        collisionPairs->clear();
-
-        //Check if the spheres are within the world boundary
-        for(int i = 0; i < numSpheres; i++){
-            if(spheres[i].center.x + spheres[i].radius > worldSize || spheres[i].center.x - spheres[i].radius < -worldSize ||
-               spheres[i].center.y + spheres[i].radius > worldSize || spheres[i].center.y - spheres[i].radius < -worldSize ||
-               spheres[i].center.z + spheres[i].radius > worldSize || spheres[i].center.z - spheres[i].radius < -worldSize){
-                // If the sphere is out of bounds, simply reverse its velocity in certain direction component
-                if(spheres[i].center.x + spheres[i].radius > worldSize){
-                    spheres[i].velocity.x = -spheres[i].velocity.x;
-                    spheres[i].center.x = worldSize - spheres[i].radius;
-                } else if(spheres[i].center.x - spheres[i].radius < -worldSize){
-                    spheres[i].velocity.x = -spheres[i].velocity.x;
-                    spheres[i].center.x = -worldSize + spheres[i].radius;
-                }
-                if(spheres[i].center.y + spheres[i].radius > worldSize){
-                    spheres[i].velocity.y = -spheres[i].velocity.y;
-                    spheres[i].center.y = worldSize - spheres[i].radius;
-                } else if(spheres[i].center.y - spheres[i].radius < -worldSize){
-                    spheres[i].velocity.y = -spheres[i].velocity.y;
-                    spheres[i].center.y = -worldSize + spheres[i].radius;
-                }
-                if(spheres[i].center.z + spheres[i].radius > worldSize){
-                    spheres[i].velocity.z = -spheres[i].velocity.z;
-                    spheres[i].center.z = worldSize - spheres[i].radius;
-                } else if(spheres[i].center.z - spheres[i].radius < -worldSize){
-                    spheres[i].velocity.z = -spheres[i].velocity.z;
-                    spheres[i].center.z = -worldSize + spheres[i].radius;
-                }
+    void setMethod(int newMethod) { method = newMethod; }
+    int getMethod() const { return method; }
 
-            }
-        }
+    // Keep the sorted begin points of the sweep after each broad phase, for spatialIndex()
+    // Off by default, the copy costs a pass over the endpoints that only a world being drawn needs
+    void setKeepSpatialIndex(bool keep) { keepIndex = keep; }
+    // Spheres sorted along each axis by the last broad phase, its slack is left to the caller moving the spheres
+    const SpatialIndex& spatialIndex() const { return index; }
+    SpatialIndex& spatialIndex() { return index; }
 
-        // Sweep and Prune method
-        if(method == 0){
-            std::vector<Point> PointX;
-            std::vector<Point> PointY;
-            std::vector<Point> PointZ;
+    // Pairs found by the last broad phase, reduced to the colliding ones by the narrow phase
+    const ArenaVector<CollisionPair>& getCollisionPairs() const { return collisionPairs; }
 
-            for (int i = 0; i < numSpheres; i++){
-                PointX.push_back({spheres[i].center.x - spheres[i].radius, true, i});
-                PointX.push_back({spheres[i].center.x + spheres[i].radius, false, i});
+    // GJK iterations of the last narrow phase, over all of its pairs; always 0 without CDE_ENABLE_STATS
+    uint64_t gjkIterations() const { return lastGjkIterations; }
 
-                PointY.push_back({spheres[i].center.y - spheres[i].radius, true, i});
-                PointY.push_back({spheres[i].center.y + spheres[i].radius, false, i});
-
-                PointZ.push_back({spheres[i].center.z - spheres[i].radius, true, i});
-                PointZ.push_back({spheres[i].center.z + spheres[i].radius, false, i});
-            }
-
-            // Create a Utils instance for sorting and intersection
-            Utils utils;
-
-            // Sort the points in each dimension
-            utils.insertionSort(PointX);
-            utils.insertionSort(PointY);
-            utils.insertionSort(PointZ);
-
-            std::unordered_set<int> activeSet;
-            std::vector<std::pair<SphereBV*, SphereBV*>> potentialCollisionPairsX;
-            std::vector<std::pair<SphereBV*, SphereBV*>> potentialCollisionPairsY;
-            std::vector<std::pair<SphereBV*, SphereBV*>> potentialCollisionPairsZ;
+    // Arenas the pool given to beginStep() needs: one per worker, then one for each axis of the sweep
+    static int requiredArenas(int numWorkers) {
+        return numWorkers + 3;
+    }
 
-            // Iterate through the sorted points and find potential collision pairs
-            for(auto &point: PointX) {
-                if(point.isBeginning) {
-                    for(int activeId : activeSet){
-                        potentialCollisionPairsX.push_back({&spheres[point.id], &spheres[activeId]});
-                    }
-                    activeSet.insert(point.id);
-                } else {
-                    activeSet.erase(point.id);
-                }
-            }
-            activeSet.clear();
+    // Start a new step, every temporary of the step is allocated from the given arenas
+    // The arenas must have been reset by the caller, the previous step's containers are dropped without freeing
+    // Without a JobSystem the step runs on the calling thread, as a single worker
+    void beginStep(FrameArenaPool* frameArenas, JobSystem* jobSystem = nullptr) {
+        int numWorkers = jobSystem ? jobSystem->numWorkers() : 1;
+        if (frameArenas->size() < requiredArenas(numWorkers))
+            throw std::runtime_error("CollisionDetection needs one frame arena per worker plus one per sweep axis");
+        firstAxisArena = numWorkers;
+        arenas = frameArenas;
+        jobs = jobSystem;
+        arena = &arenas->arena(0);
+        collisionPairs = ArenaVector<CollisionPair>(ArenaAllocator<CollisionPair>(arena));
+        for (int axis = 0; axis < 3; axis++)
+            axes[axis].bind(&arenas->arena(firstAxisArena + axis));
+        potentialCollisionPairsXY = ArenaVector<uint64_t>(ArenaAllocator<uint64_t>(arena));
+        tilePairs = ArenaVector<uint32_t>(ArenaAllocator<uint32_t>(arena));
+        bruteForceKeys = ArenaVector<uint64_t>(ArenaAllocator<uint64_t>(arena));
+        for (PairSink& sink : axisSinks)
+            sink.begin(*arenas, numWorkers);
+        bruteForceSink.begin(*arenas, numWorkers);
+        chunkKept = ArenaVector<uint32_t>(ArenaAllocator<uint32_t>(arena));
+        chunkIterations = ArenaVector<uint32_t>(ArenaAllocator<uint32_t>(arena));
+        lastBatch = ArenaVector<int>(ArenaAllocator<int>(arena));
+        pairBatch = ArenaVector<int>(ArenaAllocator<int>(arena));
+        batchStart = ArenaVector<uint32_t>(ArenaAllocator<uint32_t>(arena));
+        batchCursor = ArenaVector<uint32_t>(ArenaAllocator<uint32_t>(arena));
+        batchedPairs = ArenaVector<CollisionPair>(ArenaAllocator<CollisionPair>(arena));
+    }
 
-            for(auto &point: PointY) {
-                if(point.isBeginning) {
-                    for(int activeId : activeSet){
-                        potentialCollisionPairsY.push_back({&spheres[point.id], &spheres[activeId]});
-                    }
-                    activeSet.insert(point.id);
-                } else {
-                    activeSet.erase(point.id);
-                }
-            }
-            activeSet.clear();
+    // Broad Collision Detection
+    void broadCollisionDetection(){
+        if (!arena)
+            throw std::runtime_error("CollisionDetection::beginStep() must be called before the broad phase");
+        collisionPairs.clear();
+        numSpheres = spheres->size();
+        index.valid = keepIndex && method == 0; // Only the sweep sorts the spheres
 
-            for(auto &point: PointZ) {
-                if(point.isBeginning) {
-                    for(int activeId : activeSet){
-                        potentialCollisionPairsZ.push_back({&spheres[point.id], &spheres[activeId]});
-                    }
-                    activeSet.insert(point.id);
-                } else {
-                    activeSet.erase(point.id);
-                }
+        // The world boundary is handled by the integration kernel (SimdKernels.h) at the end of the step
+        // Sweep and Prune method
+        if(method == 0){
+            // Sort and sweep each axis, then intersect the three sets of candidate pairs
+            // The axes are independent, with a JobSystem they run as concurrent tasks of a graph
+            if (jobs) {
+                if (sweepGraph.size() == 0)
+                    buildSweepGraph();
+                jobs->run(sweepGraph);
+            } else {
+                for (int axis = 0; axis < 3; axis++)
+                    processAxis(axis);
+                intersectAxes();
             }
-            activeSet.clear();
-
-            // Find the intersection of the three sets of potential collision pairs
-            std::vector<std::pair<SphereBV*, SphereBV*>> potentialCollisionPairs;
-            potentialCollisionPairs = utils.threeSetIntersectionUnordered(potentialCollisionPairsX, potentialCollisionPairsY, potentialCollisionPairsZ);
-            *collisionPairs = potentialCollisionPairs; 
 
         } else if(method == 1) {
-            // Handle by brute force method
-            for(int i = 0; i < numSpheres; i++){
-                for(int j = i + 1; j < numSpheres; j++){
-                    if(spheres[i].intersects(spheres[j])){
-                        collisionPairs->push_back({&spheres[i], &spheres[j]});
-                    }
-                }
-            }
+            // Handle by brute force method, comparing squared distances over the SoA arrays
+            bruteForce();
         } else if(method == 2){
             // TODO: Handle by grid method
         }
@@ -158,54 +155,82 @@ public:
 
     //Narrow Collision Detection using the standard GJK algorithm
     void narrowCollisionDetection() {
-        for(auto &pair : *collisionPairs){
-            SphereBV* sphereA = pair.first;
-            SphereBV* sphereB = pair.second;
-
-            // Check if the spheres are colliding using GJK algorithm
-            if(!GJK(sphereA, sphereB)){
-                // If not colliding, remove the pair from the collision pairs
-                collisionPairs->erase(std::remove(collisionPairs->begin(), collisionPairs->end(), pair), collisionPairs->end());
-            }
+        // Every chunk of pairs is filtered in place, then the kept pairs of the chunks are moved together
+        // in chunk order, so the result doesn't depend on how the chunks were scheduled
+        const int count = static_cast<int>(collisionPairs.size());
+        const int numChunks = (count + narrowGrainSize - 1) / narrowGrainSize;
+        chunkKept.resize(numChunks);
+        CDE_STATS(chunkIterations.assign(numChunks, 0));
+        forEachChunk(0, count, narrowGrainSize, [this](int begin, int end, int) {
+            chunkKept[begin / narrowGrainSize] = static_cast<uint32_t>(narrowRange(begin, end));
+        });
+        CDE_STATS(lastGjkIterations = 0);
+        CDE_STATS(for (uint32_t iterations : chunkIterations) lastGjkIterations += iterations);
+
+        size_t kept = 0;
+        for (int chunk = 0; chunk < numChunks; chunk++) {
+            size_t begin = static_cast<size_t>(chunk) * narrowGrainSize;
+            if (kept != begin)
+                std::copy(collisionPairs.begin() + begin, collisionPairs.begin() + begin + chunkKept[chunk], collisionPairs.begin() + kept);
+            kept += chunkKept[chunk];
         }
-
+        collisionPairs.resize(kept);
     }
 
     //Simply reverse the velocity between two possible spheres
     void handleCollision() {
-        for(auto &pair : *collisionPairs){
-            SphereBV* sphereA = pair.first;
-            SphereBV* sphereB = pair.second;
-
-            // Simply reverse their velocity direction using conservation of momentum and energy
-            glm::vec3 velocityBefore_A = sphereA->velocity;
-            glm::vec3 velocityBefore_B = sphereB->velocity;
-
-            float mass_A = sphereA->mass;
-            float mass_B = sphereB->mass;
-
-            // updates:
-            // v′ = ((m - M) / (m + M)) · v + (2M / (m + M)) · V
-            // V′ = (2m / (m + M)) · v + ((M - m) / (m + M)) · V
-            glm::vec3 velocityAfter_A = ((mass_A - mass_B) / (mass_A + mass_B)) * velocityBefore_A + (2 * mass_B / (mass_A + mass_B)) * velocityBefore_B;
-            glm::vec3 velocityAfter_B = (2 * mass_A / (mass_A + mass_B)) * velocityBefore_A + ((mass_B - mass_A) / (mass_A + mass_B)) * velocityBefore_B;
-            
-            sphereA->velocity = velocityAfter_A;
-            sphereB->velocity = velocityAfter_B;
+        const size_t count = collisionPairs.size();
+        if (!jobs || jobs->numWorkers() == 1 || count < parallelResponseThreshold) {
+            for(const CollisionPair &pair : collisionPairs)
+                resolveCollision(pair.first, pair.second);
+            return;
+        }
 
+        // Split the pairs into batches in which no sphere appears twice, so a batch can be resolved in parallel.
+        // A pair goes in the batch after the last one touching either of its spheres, so every sphere still
+        // sees its pairs in the original order and the result is the same as the sequential loop.
+        lastBatch.assign(numSpheres, -1);
+        pairBatch.resize(count);
+        int numBatches = 0;
+        for (size_t k = 0; k < count; k++) {
+            const CollisionPair& pair = collisionPairs[k];
+            int batch = std::max(lastBatch[pair.first], lastBatch[pair.second]) + 1;
+            pairBatch[k] = batch;
+            lastBatch[pair.first] = batch;
+            lastBatch[pair.second] = batch;
+            numBatches = std::max(numBatches, batch + 1);
+        }
 
+        // Group the pairs by batch, keeping their order inside a batch
+        batchStart.assign(numBatches + 1, 0);
+        for (size_t k = 0; k < count; k++)
+            batchStart[pairBatch[k] + 1]++;
+        for (int batch = 0; batch < numBatches; batch++)
+            batchStart[batch + 1] += batchStart[batch];
+        batchCursor.assign(batchStart.begin(), batchStart.end() - 1);
+        batchedPairs.resize(count);
+        for (size_t k = 0; k < count; k++)
+            batchedPairs[batchCursor[pairBatch[k]]++] = collisionPairs[k];
+
+        for (int batch = 0; batch < numBatches; batch++) {
+            jobs->parallelFor(static_cast<int>(batchStart[batch]), static_cast<int>(batchStart[batch + 1]), responseGrainSize,
+                [this](int begin, int end, int) {
+                    for (int k = begin; k < end; k++)
+                        resolveCollision(batchedPairs[k].first, batchedPairs[k].second);
+                });
         }
     }
 
         // GJK main function
         // Check if two spheres are colliding using the GJK algorithm
-        bool GJK(SphereBV* A, SphereBV* B) {
+        // iterationsUsed (if any) gets the number of iterations run, the support points added after the first one
+        bool GJK(const SphereBV& A, const SphereBV& B, int* iterationsUsed = nullptr) {
             // 初始搜索方向
-            glm::vec3 d = A->center - B->center;
+            glm::vec3 d = A.center() - B.center();
             if(glm::length(d) < 1e-6)
                 d = glm::vec3(1.0f, 0.0f, 0.0f);
             
-            std::vector<glm::vec3> simplex;
+            Simplex simplex;
             glm::vec3 supportPoint = support(A, B, d);
             simplex.push_back(supportPoint);
             d = -supportPoint;
@@ -216,6 +241,8 @@ public:
             
             while (iterations < MAX_ITERATIONS) {
                 iterations++;
+                if (iterationsUsed)
+                    *iterationsUsed = iterations;
                 glm::vec3 newPoint = support(A, B, d);
                 
                 // Check if we've made progress
@@ -245,17 +272,334 @@ public:
 
 
 private:
-    SphereBV* spheres;
+    // Sweep state of one axis, each axis can be processed by a different worker
+    struct AxisSweep {
+        ArenaVector<Point> points;
+        // Candidate pairs of the axis, encoded as (smaller index << 32) | larger index
+        ArenaVector<uint64_t> pairs;
+        // Radix sort buffers of the endpoints
+        ArenaVector<uint32_t> keys;
+        ArenaVector<uint32_t> order;
+        ArenaVector<uint32_t> keysScratch;
+        ArenaVector<uint32_t> orderScratch;
+
+        void bind(FrameArena* arena) {
+            points = ArenaVector<Point>(ArenaAllocator<Point>(arena));
+            pairs = ArenaVector<uint64_t>(ArenaAllocator<uint64_t>(arena));
+            keys = ArenaVector<uint32_t>(ArenaAllocator<uint32_t>(arena));
+            order = ArenaVector<uint32_t>(ArenaAllocator<uint32_t>(arena));
+            keysScratch = ArenaVector<uint32_t>(ArenaAllocator<uint32_t>(arena));
+            orderScratch = ArenaVector<uint32_t>(ArenaAllocator<uint32_t>(arena));
+        }
+    };
+
+    static constexpr int bruteForceTileSize = 512;            // Spheres per brute force tile, the SoA data of a tile is 8 KB
+    static constexpr int sweepGrainSize = 4096;               // Minimum endpoints per sweep chunk
+    static constexpr int narrowGrainSize = 512;               // Pairs per narrow phase chunk
+    static constexpr size_t parallelResponseThreshold = 1024; // Fewer pairs are resolved sequentially
+    static constexpr int responseGrainSize = 256;
+
+    SphereStore* spheres;
     int numSpheres;
     float worldSize;
-    std::vector<std::pair<SphereBV*, SphereBV*>>* collisionPairs;
     int method;
+    bool keepIndex;
+    SpatialIndex index;     // Persistent, see recordIndexAxis
+    FrameArenaPool* arenas; // Arenas of the current step, one per worker
+    JobSystem* jobs;        // Null to run the step on the calling thread
+    FrameArena* arena;      // Arena of the calling thread
+    int firstAxisArena;     // Index of the arena of the X axis sweep, Y and Z follow
+    TaskGraph sweepGraph;   // Sort and sweep of the three axes, then their intersection
+
+    // Per-step containers, all of them live in the current step's arenas
+    ArenaVector<CollisionPair> collisionPairs;
+    AxisSweep axes[3];
+    PairSink axisSinks[3]; // Pairs found by each worker on each axis
+    ArenaVector<uint64_t> potentialCollisionPairsXY;
+    // Brute force
+    ArenaVector<uint32_t> tilePairs;        // (tile I << 16) | tile J for every J >= I
+    PairSink bruteForceSink;                // Pair keys found by each worker
+    ArenaVector<uint64_t> bruteForceKeys;   // All of them, sorted
+    ArenaVector<uint32_t> chunkKept; // Pairs kept by each narrow phase chunk
+    ArenaVector<uint32_t> chunkIterations; // GJK iterations of each narrow phase chunk, with CDE_ENABLE_STATS
+    uint64_t lastGjkIterations;
+    // Collision response batches
+    ArenaVector<int> lastBatch;  // Last batch touching each sphere
+    ArenaVector<int> pairBatch;  // Batch of each pair
+    ArenaVector<uint32_t> batchStart;
+    ArenaVector<uint32_t> batchCursor;
+    ArenaVector<CollisionPair> batchedPairs;
+
+    // Run body(chunkBegin, chunkEnd, worker) over [begin, end), on the job system if there is one
+    template <typename Body>
+    void forEachChunk(int begin, int end, int grainSize, const Body& body) {
+        if (jobs) {
+            jobs->parallelFor(begin, end, grainSize, body);
+            return;
+        }
+        for (int chunk = begin; chunk < end; chunk += grainSize)
+            body(chunk, std::min(end, chunk + grainSize), 0);
+    }
+
+    const float* axisCenters(int axis) const {
+        return axis == 0 ? spheres->centerX.data() : axis == 1 ? spheres->centerY.data() : spheres->centerZ.data();
+    }
+
+    void buildSweepGraph() {
+        TaskGraph::TaskId intersect = sweepGraph.add([this](int) { intersectAxes(); });
+        for (int axis = 0; axis < 3; axis++) {
+            TaskGraph::TaskId sweep = sweepGraph.add([this, axis](int) { processAxis(axis); });
+            sweepGraph.precede(sweep, intersect);
+        }
+    }
+
+    // Sort the endpoints of one axis, sweep them and sort the resulting pair keys
+    // The axis buffers come from the axis's own arena, so their memory use doesn't depend on the worker running
+    // the task; the sweep itself is split among the workers through the axis's PairSink
+    void processAxis(int axis) {
+        AxisSweep& sweep = axes[axis];
+        {
+            CDE_TRACE_SCOPE("Sort endpoints");
+            sortEndpoints(sweep, axisCenters(axis), spheres->radius.data());
+            if (index.valid)
+                recordIndexAxis(axis);
+        }
+        {
+            CDE_TRACE_SCOPE("Sweep axis");
+            sweepAxis(sweep, axisSinks[axis]);
+        }
+        CDE_TRACE_SCOPE("Sort axis pairs");
+        std::sort(sweep.pairs.begin(), sweep.pairs.end());
+    }
+
+    // Keep the pairs found on all three axes
+    // The pair keys are sorted so the intersection is a linear merge instead of two hash sets
+    // This runs after the three sweeps, when nothing else uses the calling thread's arena the pairs live in
+    void intersectAxes() {
+        CDE_TRACE_SCOPE("Intersect axes");
+        const ArenaVector<uint64_t>& pairsX = axes[0].pairs;
+        const ArenaVector<uint64_t>& pairsY = axes[1].pairs;
+        const ArenaVector<uint64_t>& pairsZ = axes[2].pairs;
+        potentialCollisionPairsXY.reserve(std::min(pairsX.size(), pairsY.size()));
+        std::set_intersection(pairsX.begin(), pairsX.end(), pairsY.begin(), pairsY.end(),
+                              std::back_inserter(potentialCollisionPairsXY));
+
+        size_t z = 0;
+        for(uint64_t key : potentialCollisionPairsXY){
+            while(z < pairsZ.size() && pairsZ[z] < key)
+                z++;
+            if(z < pairsZ.size() && pairsZ[z] == key){
+                collisionPairs.push_back({static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key & 0xffffffffu)});
+            }
+        }
+    }
+
+    // Tiled brute force: the spheres are cut in tiles and every pair of tiles (I, J >= I) is one unit of work.
+    // Each row of tile I is tested against the whole of tile J with the vectorized row kernel, J's arrays stay
+    // in L1 for all the rows. The tile pairs are handed out to the workers dynamically, so the triangular
+    // iteration space is spread evenly, and the hits go to a PairSink. The merged keys are sorted, so the pairs
+    // come out in the same order as a sequential double loop.
+    void bruteForce() {
+        const SimdKernelTable& kernels = simdKernels();
+        const int numTiles = (numSpheres + bruteForceTileSize - 1) / bruteForceTileSize;
+        if (numTiles > 0xffff)
+            throw std::runtime_error("Too many spheres for the brute force broad phase");
+
+        tilePairs.clear();
+        for (int tileI = 0; tileI < numTiles; tileI++)
+            for (int tileJ = tileI; tileJ < numTiles; tileJ++)
+                tilePairs.push_back(static_cast<uint32_t>(tileI) << 16 | static_cast<uint32_t>(tileJ));
+
+        const int numTilePairs = static_cast<int>(tilePairs.size());
+        const int numWorkers = jobs ? jobs->numWorkers() : 1;
+        const int grainSize = std::max(1, numTilePairs / (numWorkers * 8));
+        forEachChunk(0, numTilePairs, grainSize, [&](int begin, int end, int worker) {
+            uint32_t hits[bruteForceTileSize];
+            for (int t = begin; t < end; t++) {
+                int tileI = static_cast<int>(tilePairs[t] >> 16);
+                int tileJ = static_cast<int>(tilePairs[t] & 0xffff);
+                int iEnd = std::min(numSpheres, (tileI + 1) * bruteForceTileSize);
+                int jBegin = tileJ * bruteForceTileSize;
+                int jEnd = std::min(numSpheres, jBegin + bruteForceTileSize);
+                for (int i = tileI * bruteForceTileSize; i < iEnd; i++) {
+                    // On the diagonal tile only the spheres after i
+                    int hitCount = kernels.overlapRow(*spheres, i, std::max(jBegin, i + 1), jEnd, hits);
+                    for (int h = 0; h < hitCount; h++)
+                        bruteForceSink.push(worker, static_cast<uint64_t>(i) << 32 | hits[h]);
+                }
+            }
+        });
+
+        bruteForceSink.merge(bruteForceKeys, jobs);
+        std::sort(bruteForceKeys.begin(), bruteForceKeys.end());
+        collisionPairs.resize(bruteForceKeys.size());
+        for (size_t k = 0; k < bruteForceKeys.size(); k++)
+            collisionPairs[k] = {static_cast<uint32_t>(bruteForceKeys[k] >> 32), static_cast<uint32_t>(bruteForceKeys[k] & 0xffffffffu)};
+    }
+
+    // Narrow phase of the pairs [begin, end): compact the colliding ones to the front of the range, return how many
+    size_t narrowRange(int begin, int end) {
+        CollisionPair* pairs = collisionPairs.data() + begin;
+        // Drop the clearly separated pairs with a vectorized distance test first, GJK only sees the close ones
+        size_t count = simdKernels().rejectSeparatedPairs(*spheres, pairs, static_cast<size_t>(end - begin));
+
+        // Keep only the pairs confirmed by GJK
+        size_t kept = 0;
+        CDE_STATS(uint32_t iterations = 0);
+        for(size_t k = 0; k < count; k++){
+            const CollisionPair pair = pairs[k];
+
+            // Check if the spheres are colliding using GJK algorithm
+            CDE_STATS(int pairIterations = 0);
+            if(GJK(SphereBV(spheres, pair.first), SphereBV(spheres, pair.second) CDE_STATS(, &pairIterations))){
+                pairs[kept++] = pair;
+            }
+            CDE_STATS(iterations += pairIterations);
+        }
+        CDE_STATS(chunkIterations[begin / narrowGrainSize] = iterations);
+        return kept;
+    }
+
+    // Exchange the velocities of two colliding spheres
+    void resolveCollision(uint32_t a, uint32_t b) {
+        float* velocityX = spheres->velocityX.data();
+        float* velocityY = spheres->velocityY.data();
+        float* velocityZ = spheres->velocityZ.data();
+        const float* inverseMass = spheres->inverseMass.data();
+
+        // Simply reverse their velocity direction using conservation of momentum and energy
+        glm::vec3 velocityBefore_A(velocityX[a], velocityY[a], velocityZ[a]);
+        glm::vec3 velocityBefore_B(velocityX[b], velocityY[b], velocityZ[b]);
+
+        float inverseMass_A = inverseMass[a];
+        float inverseMass_B = inverseMass[b];
+        float inverseMassSum = inverseMass_A + inverseMass_B;
+
+        // updates:
+        // v′ = ((m - M) / (m + M)) · v + (2M / (m + M)) · V
+        // V′ = (2m / (m + M)) · v + ((M - m) / (m + M)) · V
+        // With inverse masses w = 1/m and W = 1/M: (m - M) / (m + M) = (W - w) / (w + W) and 2M / (m + M) = 2w / (w + W)
+        glm::vec3 velocityAfter_A = ((inverseMass_B - inverseMass_A) / inverseMassSum) * velocityBefore_A + (2 * inverseMass_A / inverseMassSum) * velocityBefore_B;
+        glm::vec3 velocityAfter_B = (2 * inverseMass_B / inverseMassSum) * velocityBefore_A + ((inverseMass_A - inverseMass_B) / inverseMassSum) * velocityBefore_B;
+
+        velocityX[a] = velocityAfter_A.x;
+        velocityY[a] = velocityAfter_A.y;
+        velocityZ[a] = velocityAfter_A.z;
+        velocityX[b] = velocityAfter_B.x;
+        velocityY[b] = velocityAfter_B.y;
+        velocityZ[b] = velocityAfter_B.z;
+    }
+
+    // Rebuild the begin/end points of every sphere along one axis, sorted
+    // The points are regenerated in index order every step, so this is a full sort: the kernel turns the
+    // endpoints into order preserving integer keys and an LSD radix sort (3 passes of 11 bits) orders them.
+    // Begin points come before end points in the input and the sort is stable, so at equal values a begin
+    // sorts before an end, like Point::operator<.
+    void sortEndpoints(AxisSweep& sweep, const float* center, const float* radius) {
+        const int count = 2 * numSpheres;
+        sweep.keys.resize(count);
+        sweep.order.resize(count);
+        sweep.keysScratch.resize(count);
+        sweep.orderScratch.resize(count);
+        simdKernels().endpointKeys(center, radius, numSpheres, sweep.keys.data());
+
+        uint32_t* keys = sweep.keys.data();
+        uint32_t* order = sweep.order.data();
+        uint32_t* keysOut = sweep.keysScratch.data();
+        uint32_t* orderOut = sweep.orderScratch.data();
+        for (int e = 0; e < count; e++) order[e] = static_cast<uint32_t>(e);
+
+        const int radixBits = 11;
+        const uint32_t radixMask = (1u << radixBits) - 1;
+        for (int shift = 0; shift < 32; shift += radixBits) {
+            uint32_t offsets[1u << radixBits] = {};
+            for (int e = 0; e < count; e++) offsets[(keys[e] >> shift) & radixMask]++;
+            uint32_t sum = 0;
+            for (uint32_t& offset : offsets) {
+                uint32_t bucket = offset;
+                offset = sum;
+                sum += bucket;
+            }
+            for (int e = 0; e < count; e++) {
+                uint32_t position = offsets[(keys[e] >> shift) & radixMask]++;
+                keysOut[position] = keys[e];
+                orderOut[position] = order[e];
+            }
+            std::swap(keys, keysOut);
+            std::swap(order, orderOut);
+        }
+
+        ArenaVector<Point>& points = sweep.points;
+        points.resize(count);
+        for (int k = 0; k < count; k++) {
+            int endpoint = static_cast<int>(order[k]);
+            bool isBeginning = endpoint < numSpheres;
+            int i = isBeginning ? endpoint : endpoint - numSpheres;
+            points[k] = {isBeginning ? center[i] - radius[i] : center[i] + radius[i], isBeginning, i};
+        }
+    }
+
+    // Copy the sorted begin points of one axis to the spatial index
+    // The index outlives the step, so it has its own storage instead of the arenas; the axes run as concurrent
+    // tasks and each one only writes its own part of it
+    void recordIndexAxis(int axis) {
+        const ArenaVector<Point>& points = axes[axis].points;
+        SpatialIndexAxis& entries = index.axes[axis];
+        entries.begin.resize(numSpheres);
+        entries.index.resize(numSpheres);
+        int entry = 0;
+        for (const Point& point : points) {
+            if (!point.isBeginning)
+                continue;
+            entries.begin[entry] = point.value;
+            entries.index[entry] = point.id;
+            entry++;
+        }
+        if (axis == 0) {
+            const float* radius = spheres->radius.data();
+            float maxRadius = 0.0f;
+            for (int i = 0; i < numSpheres; i++)
+                maxRadius = std::max(maxRadius, radius[i]);
+            index.maxDiameter = 2.0f * maxRadius;
+        }
+    }
+
+    // Sweep the sorted points of one axis and record every pair of overlapping intervals
+    // Two intervals overlap when one of them begins while the other is open, so each begin point scans
+    // forward to the end point of its own sphere and pairs with every sphere beginning in between.
+    // The begin points are independent of each other and are split among the workers, every pair is
+    // found exactly once, by the sphere that begins first.
+    void sweepAxis(AxisSweep& sweep, PairSink& sink) {
+        const ArenaVector<Point>& points = sweep.points;
+        const int count = static_cast<int>(points.size());
+        const int numWorkers = jobs ? jobs->numWorkers() : 1;
+        const int grainSize = std::max(sweepGrainSize, count / (numWorkers * 8));
+        forEachChunk(0, count, grainSize, [&](int begin, int end, int worker) {
+            for (int k = begin; k < end; k++) {
+                if (!points[k].isBeginning)
+                    continue;
+                int id = points[k].id;
+                for (int m = k + 1; points[m].id != id; m++) {
+                    if (points[m].isBeginning)
+                        sink.push(worker, pairKey(id, points[m].id));
+                }
+            }
+        });
+        sink.merge(sweep.pairs, jobs);
+    }
+
+    // Order independent key of a pair of sphere indices
+    static uint64_t pairKey(int a, int b) {
+        uint32_t low = static_cast<uint32_t>(a < b ? a : b);
+        uint32_t high = static_cast<uint32_t>(a < b ? b : a);
+        return (static_cast<uint64_t>(low) << 32) | high;
+    }
 
     // Support function for GJK algorithm
-    glm::vec3 support(SphereBV* A, SphereBV* B, const glm::vec3 &d) {
+    glm::vec3 support(const SphereBV& A, const SphereBV& B, const glm::vec3 &d) {
         // Safety check for zero direction vector
         if (glm::length(d) < 1e-6) {
-            return A->center - B->center;
+            return A.center() - B.center();
         }
         
         // Normalize the direction to improve numerical stability
@@ -263,8 +607,8 @@ private:
         
         // For spheres, we can optimize by using the analytical solution
         // instead of checking all mesh vertices
-        glm::vec3 furthest_A = A->center + A->radius * dir;
-        glm::vec3 furthest_B = B->center - B->radius * dir;
+        glm::vec3 furthest_A = A.center() + A.radius() * dir;
+        glm::vec3 furthest_B = B.center() - B.radius() * dir;
         
         return furthest_A - furthest_B;
     }
@@ -275,7 +619,7 @@ private:
     }
 
     // Simplex 处理：针对线段（2点）情况
-    bool handleLine(std::vector<glm::vec3>& simplex, glm::vec3 &d) {
+    bool handleLine(Simplex& simplex, glm::vec3 &d) {
         glm::vec3 A = simplex.back();      // 最新点
         glm::vec3 B = simplex.front();       // 最早的点
         glm::vec3 AB = B - A;
@@ -288,7 +632,7 @@ private:
     }
 
     // Simplex 处理：针对三角形（3点）情况
-    bool handleTriangle(std::vector<glm::vec3>& simplex, glm::vec3 &d) {
+    bool handleTriangle(Simplex& simplex, glm::vec3 &d) {
         // 假定 simplex 中点的顺序为 C, B, A，其中 A 为最新添加
         glm::vec3 A = simplex[2];
         glm::vec3 B = simplex[1];
@@ -301,14 +645,14 @@ private:
         // 判断原点是否在 AB 边的区域
         glm::vec3 ABPerp = glm::cross(AB, ABC);
         if (glm::dot(ABPerp, AO) > 0) {
-            simplex.erase(simplex.begin()); // 移除 C
+            simplex.erase(0); // 移除 C
             d = tripleCross(AB, AO, AB);
             return false;
         }
         // 判断原点是否在 AC 边的区域
         glm::vec3 ACPerp = glm::cross(ABC, AC);
         if (glm::dot(ACPerp, AO) > 0) {
-            simplex.erase(simplex.begin() + 1); // 移除 B
+            simplex.erase(1); // 移除 B
             d = tripleCross(AC, AO, AC);
             return false;
         }
@@ -323,7 +667,7 @@ private:
     }
 
     // Simplex 处理：针对四面体（4点）情况
-    bool handleTetrahedron(std::vector<glm::vec3>& simplex, glm::vec3 &d) {
+    bool handleTetrahedron(Simplex& simplex, glm::vec3 &d) {
         // 假定 simplex 点的顺序为 D, C, B, A，其中 A 为最新
         glm::vec3 A = simplex[3];
         glm::vec3 B = simplex[2];
@@ -334,17 +678,17 @@ private:
         glm::vec3 ACD = glm::cross(C - A, D - A);
         glm::vec3 ADB = glm::cross(D - A, B - A);
         if(glm::dot(ABC, AO) > 0) {
-            simplex.erase(simplex.begin()); // 移除 D
+            simplex.erase(0); // 移除 D
             d = ABC;
             return false;
         }
         if(glm::dot(ACD, AO) > 0) {
-            simplex.erase(simplex.begin() + 2); // 移除 B
+            simplex.erase(2); // 移除 B
             d = ACD;
             return false;
         }
         if(glm::dot(ADB, AO) > 0) {
-            simplex.erase(simplex.begin() + 1); // 移除 C
+            simplex.erase(1); // 移除 C
             d = ADB;
             return false;
         }
@@ -353,7 +697,7 @@ private:
     }
 
     // 根据 simplex 当前点数量选择对应的处理函数
-    bool handleSimplex(std::vector<glm::vec3>& simplex, glm::vec3 &d) {
+    bool handleSimplex(Simplex& simplex, glm::vec3 &d) {
         if (simplex.size() == 2)
             return handleLine(simplex, d);
         else if (simplex.size() == 3)
@@ -0,0 +1,10 @@
+#pragma once
+#include <cstdint>
+
+// A pair of spheres, stored as 32-bit indices into the SphereStore rather than pointers
+// Indices stay valid when the store's arrays are reallocated, and a pair takes 8 bytes instead of 16
+struct CollisionPair {
+    uint32_t first;
+    uint32_t second;
+};
+static_assert(sizeof(CollisionPair) == 8, "CollisionPair should stay two 32-bit indices");
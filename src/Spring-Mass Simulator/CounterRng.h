@@ -0,0 +1,58 @@
+#pragma once
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+//Counter-based random numbers for building a scene.
+//Every value is a hash of (seed, stream, counter) with the SplitMix64 finalizer, there is no state shared between
+//streams. With one stream per sphere, a sphere gets the same values whichever thread builds it and in whatever
+//order, so a seed reproduces the exact same scene for any number of threads.
+//Draw the values of one stream in separate statements: the evaluation order of function arguments is unspecified.
+
+class CounterRng
+{
+public:
+    CounterRng(uint64_t seed, uint64_t stream) : key(mix(seed + golden * (stream + 1))), counter(0) {}
+
+    uint64_t nextU64() {
+        return mix(key + golden * ++counter);
+    }
+
+    // Uniform in [min, max)
+    float randomFloat(float min, float max) {
+        float unit = static_cast<float>(nextU64() >> 40) * (1.0f / 16777216.0f); // Top 24 bits, exact in a float
+        return min + (max - min) * unit;
+    }
+
+    // Normal distribution (Box-Muller), uses two values of the stream
+    float gaussianFloat(float mean, float deviation) {
+        float u1 = 1.0f - randomFloat(0.0f, 1.0f); // In (0, 1], log(0) is never taken
+        float u2 = randomFloat(0.0f, 1.0f);
+        return mean + deviation * std::sqrt(-2.0f * std::log(u1)) * std::cos(6.28318531f * u2);
+    }
+
+    // Uniform in [min, max]
+    int randomInt(int min, int max) {
+        if (max <= min)
+            return min;
+        uint64_t range = static_cast<uint64_t>(static_cast<int64_t>(max) - min + 1);
+        return min + static_cast<int>(nextU64() % range);
+    }
+
+    // Seed picked from the clock, for runs that don't need to be reproduced
+    static uint64_t clockSeed() {
+        return mix(static_cast<uint64_t>(std::chrono::high_resolution_clock::now().time_since_epoch().count()));
+    }
+
+private:
+    static constexpr uint64_t golden = 0x9E3779B97F4A7C15ull; // 2^64 / golden ratio, the SplitMix64 increment
+
+    uint64_t key;
+    uint64_t counter;
+
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+};
@@ -0,0 +1,71 @@
+#include "CpuFeatures.h"
+#include "SimdKernels.h"
+
+#ifdef CDE_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#ifdef CDE_X86
+
+static void cpuid(int leaf, int subleaf, unsigned int regs[4]) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuidex(info, leaf, subleaf);
+    for (int i = 0; i < 4; i++) regs[i] = static_cast<unsigned int>(info[i]);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Register state the OS saves on a context switch (XCR0)
+static unsigned long long osSavedState() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+static CpuFeatures detect() {
+    CpuFeatures features;
+    unsigned int regs[4];
+
+    cpuid(0, 0, regs);
+    unsigned int maxLeaf = regs[0];
+
+    cpuid(1, 0, regs);
+    features.sse2 = (regs[3] & (1u << 26)) != 0;
+    bool osxsave = (regs[2] & (1u << 27)) != 0;
+    bool avx = (regs[2] & (1u << 28)) != 0;
+    if (!osxsave || !avx || maxLeaf < 7)
+        return features;
+
+    unsigned long long state = osSavedState();
+    bool osAvx = (state & 0x6) == 0x6;       // XMM and YMM
+    bool osAvx512 = (state & 0xe6) == 0xe6;  // plus opmask and ZMM
+
+    cpuid(7, 0, regs);
+    features.avx2 = osAvx && (regs[1] & (1u << 5)) != 0;
+    features.avx512f = osAvx512 && (regs[1] & (1u << 16)) != 0;
+    return features;
+}
+
+#else
+
+static CpuFeatures detect() {
+    return CpuFeatures();
+}
+
+#endif
+
+const CpuFeatures& CpuFeatures::get() {
+    static const CpuFeatures features = detect();
+    return features;
+}
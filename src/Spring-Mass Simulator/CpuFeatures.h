@@ -0,0 +1,14 @@
+#pragma once
+
+//Instruction sets of the CPU we are running on, read once from CPUID.
+//A feature only counts as available when the OS also saves the matching registers on a context switch (XGETBV),
+//otherwise an AVX instruction would still fault on a CPU that reports it.
+
+struct CpuFeatures {
+    bool sse2 = false;
+    bool avx2 = false;
+    bool avx512f = false;
+
+    // Features of this machine, detected on the first call
+    static const CpuFeatures& get();
+};
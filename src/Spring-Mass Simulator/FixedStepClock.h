@@ -0,0 +1,63 @@
+#pragma once
+#include <cmath>
+
+//Turns the wall clock time that passed between two frames into a number of fixed simulation steps.
+//The time not covered by a whole step is carried over to the next frame, so the simulated time follows the wall
+//clock whatever the frame rate, and the leftover fraction of a step is used to interpolate the rendered state.
+//A frame never runs more than maxStepsPerFrame steps: when the steps are slower than real time the extra time is
+//dropped instead of carried over, otherwise every frame would owe more steps than the last (spiral of death).
+
+class FixedStepClock
+{
+public:
+    explicit FixedStepClock(float stepTime = 0.016f, int maxStepsPerFrame = 8)
+        : step(stepTime), maxSteps(maxStepsPerFrame), accumulator(0.0), dropped(0) {}
+
+    float stepTime() const { return step; }
+    void setStepTime(float stepTime) {
+        step = stepTime;
+        if (accumulator > step) accumulator = std::fmod(accumulator, static_cast<double>(step));
+    }
+
+    int maxStepsPerFrame() const { return maxSteps; }
+    void setMaxStepsPerFrame(int maxStepsPerFrame) { maxSteps = maxStepsPerFrame < 1 ? 1 : maxStepsPerFrame; }
+
+    // Add the wall clock time since the last call, returns the number of steps to run now
+    int advance(double elapsedSeconds) {
+        accumulator += elapsedSeconds;
+        double owed = std::floor(accumulator / step);
+        int steps = owed > maxSteps ? maxSteps : static_cast<int>(owed);
+        if (owed > maxSteps) {
+            dropped += static_cast<long long>(owed) - maxSteps;
+            accumulator = std::fmod(accumulator, static_cast<double>(step));
+        } else {
+            accumulator -= steps * static_cast<double>(step);
+        }
+        return steps;
+    }
+
+    // How far the wall clock is past the last step, in steps from 0 to 1
+    // Rendering previous + (current - previous) * alpha shows the state in between the last two steps
+    float interpolationAlpha() const {
+        float alpha = static_cast<float>(accumulator / step);
+        return alpha < 1.0f ? alpha : 1.0f;
+    }
+
+    // Seconds until the next step is due
+    double timeToNextStep() const {
+        return accumulator < step ? step - accumulator : 0.0;
+    }
+
+    long long droppedSteps() const { return dropped; } // Steps skipped by the cap since the last reset
+
+    void reset() {
+        accumulator = 0.0;
+        dropped = 0;
+    }
+
+private:
+    float step;
+    int maxSteps;
+    double accumulator; // Wall clock time not simulated yet
+    long long dropped;
+};
@@ -0,0 +1,173 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+//A bump allocator for the temporaries of one simulation step.
+//Allocations just advance an offset, nothing is freed individually, and reset() rewinds everything at the
+//start of the next step. If a step needed more than one block, reset() replaces them by a single block of the
+//peak size, so after a few steps every allocation comes from one contiguous block and the heap is not touched.
+
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t initialSize = 64 * 1024) : blockSize(initialSize), used(0), peak(0) {}
+
+    ~FrameArena() {
+        releaseBlocks();
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Allocate bytes with the given alignment, valid until the next reset()
+    void* allocate(size_t bytes, size_t alignment) {
+        if (!blocks.empty()) {
+            if (void* p = allocateFrom(blocks.back(), bytes, alignment))
+                return p;
+        }
+
+        // Start a new block, at least twice as large as the previous one
+        size_t size = blocks.empty() ? blockSize : blocks.back().size * 2;
+        if (size < bytes + alignment) size = bytes + alignment;
+        blocks.push_back(Block{ static_cast<char*>(::operator new(size)), size, 0 });
+        return allocateFrom(blocks.back(), bytes, alignment);
+    }
+
+    // Release everything allocated since the last reset
+    // minimumSize grows the arena ahead of time, so the next steps don't have to
+    void reset(size_t minimumSize = 0) {
+        size_t total = capacity();
+        if (blocks.size() > 1 || total < minimumSize) {
+            // Fold the blocks into a single one large enough for the peak so far
+            releaseBlocks();
+            blockSize = total > peak ? total : peak;
+            if (blockSize < minimumSize) blockSize = minimumSize;
+            blocks.push_back(Block{ static_cast<char*>(::operator new(blockSize)), blockSize, 0 });
+        } else if (!blocks.empty()) {
+            blocks.back().offset = 0;
+        }
+        used = 0;
+    }
+
+    size_t bytesUsed() const { return used; }       // Bytes handed out since the last reset
+    size_t highWaterMark() const { return peak; }   // Largest bytesUsed() seen in any step
+    size_t capacity() const {
+        size_t total = 0;
+        for (const Block& block : blocks) total += block.size;
+        return total;
+    }
+
+private:
+    struct Block {
+        char* memory;
+        size_t size;
+        size_t offset;
+    };
+
+    std::vector<Block> blocks;
+    size_t blockSize;
+    size_t used;
+    size_t peak;
+
+    // Bump allocate from a block, or return nullptr if it doesn't fit
+    void* allocateFrom(Block& block, size_t bytes, size_t alignment) {
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.memory);
+        uintptr_t start = (base + block.offset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+        size_t end = static_cast<size_t>(start - base) + bytes;
+        if (end > block.size)
+            return nullptr;
+
+        used += end - block.offset;
+        block.offset = end;
+        if (used > peak) peak = used;
+        return reinterpret_cast<void*>(start);
+    }
+
+    void releaseBlocks() {
+        for (Block& block : blocks) ::operator delete(block.memory);
+        blocks.clear();
+    }
+};
+
+//Standard allocator adapter so std::vector can take its storage from a FrameArena.
+//deallocate() is a no-op, the memory comes back when the arena is reset.
+template <typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+    // Assigning a fresh vector must also take over its arena, that's how containers move to the next step's arena
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ArenaAllocator() noexcept : arena(nullptr) {}
+    explicit ArenaAllocator(FrameArena* arena) noexcept : arena(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        if (!arena) throw std::bad_alloc();
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T*, size_t) noexcept {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const noexcept { return arena != other.arena; }
+
+    FrameArena* arena;
+};
+
+// A vector whose storage lives in a FrameArena, it must not be used after the arena is reset
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+//One FrameArena per thread taking part in a step, so threads never share an arena.
+//Index 0 is the thread calling stepSimulation. The owner of the pool can add arenas past the workers' ones
+//for tasks that always run whole on one thread, their usage then doesn't depend on which worker ran them.
+class FrameArenaPool
+{
+public:
+    explicit FrameArenaPool(int numArenas = 1) {
+        resize(numArenas);
+    }
+
+    void resize(int numArenas) {
+        while (static_cast<int>(arenas.size()) < numArenas)
+            arenas.push_back(std::unique_ptr<FrameArena>(new FrameArena()));
+        while (static_cast<int>(arenas.size()) > numArenas)
+            arenas.pop_back();
+    }
+
+    int size() const { return static_cast<int>(arenas.size()); }
+    FrameArena& arena(int index) { return *arenas[index]; }
+    const FrameArena& arena(int index) const { return *arenas[index]; }
+
+    // Called at the start of every step
+    // The first numWorkerArenas arenas belong to workers, which take a different share of the work every step.
+    // Each of them is kept as large as the largest peak among them, so a worker taking a bigger share than it
+    // ever did still fits without growing its arena.
+    void resetAll(int numWorkerArenas = 0) {
+        size_t largestWorkerPeak = 0;
+        for (int i = 0; i < numWorkerArenas && i < size(); i++)
+            if (arenas[i]->highWaterMark() > largestWorkerPeak) largestWorkerPeak = arenas[i]->highWaterMark();
+        for (int i = 0; i < size(); i++)
+            arenas[i]->reset(i < numWorkerArenas ? largestWorkerPeak : 0);
+    }
+
+    // Sum of the per-arena high-water marks, the memory a step needs at most
+    size_t totalHighWaterMark() const {
+        size_t total = 0;
+        for (const auto& arena : arenas) total += arena->highWaterMark();
+        return total;
+    }
+
+private:
+    std::vector<std::unique_ptr<FrameArena>> arenas;
+};
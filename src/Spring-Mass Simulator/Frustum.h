@@ -0,0 +1,69 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cmath>
+
+//The six planes of a camera view frustum, extracted from a projection * view matrix.
+//Each plane is stored as (normal, distance) with the normal pointing into the frustum.
+
+struct Frustum
+{
+    glm::vec4 planes[6]; // left, right, bottom, top, near, far
+
+    // Extract the planes from a combined projection * view matrix (Gribb/Hartmann)
+    static Frustum fromMatrix(const glm::mat4& viewProjection) {
+        // glm matrices are column major, row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+        glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+        glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+        glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+        glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+        Frustum frustum;
+        frustum.planes[0] = row3 + row0;
+        frustum.planes[1] = row3 - row0;
+        frustum.planes[2] = row3 + row1;
+        frustum.planes[3] = row3 - row1;
+        frustum.planes[4] = row3 + row2;
+        frustum.planes[5] = row3 - row2;
+
+        // Normalize so that the plane distance is in world units
+        for (int i = 0; i < 6; i++) {
+            glm::vec4& p = frustum.planes[i];
+            float length = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+            p = p * (1.0f / length);
+        }
+        return frustum;
+    }
+
+    // Axis aligned box around the frustum, from its eight corners
+    void bounds(glm::vec3& low, glm::vec3& high) const {
+        low = glm::vec3(INFINITY);
+        high = glm::vec3(-INFINITY);
+        for (int x = 0; x < 2; x++) {
+            for (int y = 2; y < 4; y++) {
+                for (int z = 4; z < 6; z++) {
+                    glm::vec3 corner = intersection(planes[x], planes[y], planes[z]);
+                    low = glm::min(low, corner);
+                    high = glm::max(high, corner);
+                }
+            }
+        }
+    }
+
+    // Check if a sphere is at least partially inside the frustum
+    bool intersectsSphere(float x, float y, float z, float radius) const {
+        for (int i = 0; i < 6; i++) {
+            const glm::vec4& p = planes[i];
+            if (p.x * x + p.y * y + p.z * z + p.w < -radius)
+                return false;
+        }
+        return true;
+    }
+
+private:
+    // Point shared by three planes
+    static glm::vec3 intersection(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+        glm::vec3 na(a.x, a.y, a.z), nb(b.x, b.y, b.z), nc(c.x, c.y, c.z);
+        glm::vec3 bc = glm::cross(nb, nc);
+        return -(a.w * bc + b.w * glm::cross(nc, na) + c.w * glm::cross(na, nb)) / glm::dot(na, bc);
+    }
+};
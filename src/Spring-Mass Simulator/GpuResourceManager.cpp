@@ -0,0 +1,112 @@
+#include "GpuResourceManager.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <cstddef>
+
+GpuResourceManager::~GpuResourceManager() {
+    for (auto& entry : sphereMeshes)
+        release(entry.second.gpu);
+    release(boundary);
+    for (const auto& program : programs)
+        glDeleteProgram(program->id);
+}
+
+void GpuResourceManager::beginFrame(const glm::mat4& view, const glm::mat4& projection) {
+    frameIndex++;
+    frameUniforms.view = view;
+    frameUniforms.projection = projection;
+    frameUniforms.viewProjection = projection * view;
+
+    // The spheres of a level were all removed, its mesh went with them
+    for (auto it = sphereMeshes.begin(); it != sphereMeshes.end();) {
+        if (it->second.source.expired()) {
+            release(it->second.gpu);
+            it = sphereMeshes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+GpuProgram& GpuResourceManager::createProgram(const char* vertexShaderSource, const char* fragmentShaderSource) {
+    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertexShader, 1, &vertexShaderSource, nullptr);
+    glCompileShader(vertexShader);
+    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragmentShader, 1, &fragmentShaderSource, nullptr);
+    glCompileShader(fragmentShader);
+
+    std::unique_ptr<GpuProgram> program(new GpuProgram());
+    program->id = glCreateProgram();
+    glAttachShader(program->id, vertexShader);
+    glAttachShader(program->id, fragmentShader);
+    glLinkProgram(program->id);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    program->viewLocation = glGetUniformLocation(program->id, "view");
+    program->projectionLocation = glGetUniformLocation(program->id, "projection");
+
+    programs.push_back(std::move(program));
+    return *programs.back();
+}
+
+void GpuResourceManager::useProgram(GpuProgram& program) {
+    glUseProgram(program.id);
+    if (program.uniformsFrame != frameIndex) {
+        glUniformMatrix4fv(program.viewLocation, 1, GL_FALSE, glm::value_ptr(frameUniforms.view));
+        glUniformMatrix4fv(program.projectionLocation, 1, GL_FALSE, glm::value_ptr(frameUniforms.projection));
+        program.uniformsFrame = frameIndex;
+    }
+}
+
+const GpuMesh& GpuResourceManager::sphereMesh(const std::shared_ptr<const SphereMesh>& mesh) {
+    SphereMeshEntry& entry = sphereMeshes[mesh->getComplexityLevel()];
+    if (entry.gpu.generation != mesh->getGeneration()) {
+        const auto& verts = mesh->getVertices();
+        upload(entry.gpu, verts.data(), verts.size() * sizeof(glm::vec3), mesh->getIndices());
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glEnableVertexAttribArray(0);
+        glBindVertexArray(0);
+        entry.gpu.generation = mesh->getGeneration();
+        entry.source = mesh;
+    }
+    return entry.gpu;
+}
+
+const GpuMesh& GpuResourceManager::worldBoundary(const WorldRenderData& world) {
+    if (boundary.generation != world.boundaryGeneration) {
+        const auto& verts = world.cubicWorldVertices;
+        upload(boundary, verts.data(), verts.size() * sizeof(vertice), world.indices);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertice), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vertice), (void*)offsetof(vertice, color));
+        glEnableVertexAttribArray(1);
+        glBindVertexArray(0);
+        boundary.generation = world.boundaryGeneration;
+    }
+    return boundary;
+}
+
+// Fill the buffers of mesh, creating them on first use, and leave its vertex array bound for the attribute setup
+void GpuResourceManager::upload(GpuMesh& mesh, const void* vertices, size_t vertexBytes, const std::vector<int>& indices) {
+    if (mesh.vao == 0) {
+        glGenVertexArrays(1, &mesh.vao);
+        glGenBuffers(1, &mesh.vertexBuffer);
+        glGenBuffers(1, &mesh.indexBuffer);
+    }
+    glBindVertexArray(mesh.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer); // Recorded in the vertex array
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(int), indices.data(), GL_STATIC_DRAW);
+    mesh.indexCount = static_cast<GLsizei>(indices.size());
+    uploads++;
+}
+
+void GpuResourceManager::release(GpuMesh& mesh) {
+    if (mesh.vao == 0)
+        return;
+    glDeleteVertexArrays(1, &mesh.vao);
+    glDeleteBuffers(1, &mesh.vertexBuffer);
+    glDeleteBuffers(1, &mesh.indexBuffer);
+    mesh = GpuMesh();
+}
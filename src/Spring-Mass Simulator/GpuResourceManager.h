@@ -0,0 +1,83 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <map>
+#include <memory>
+#include <vector>
+#include "SphereMesh.h"
+#include "WorldRenderData.h"
+
+//Vertex array and buffers mirroring some source data on the GPU.
+struct GpuMesh {
+    GLuint vao = 0;
+    GLuint vertexBuffer = 0;
+    GLuint indexBuffer = 0;
+    GLsizei indexCount = 0;
+    uint64_t generation = 0; // Generation of the source data in the buffers, 0 while nothing was uploaded
+};
+
+//A linked shader program and the locations of its per-frame uniforms, looked up once at link time.
+struct GpuProgram {
+    GLuint id = 0;
+    GLint viewLocation = -1;
+    GLint projectionLocation = -1;
+    uint64_t uniformsFrame = 0; // Frame whose view and projection the program holds
+};
+
+//Camera matrices of one frame, computed once and shared by everything drawn in it.
+struct FrameUniforms {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+};
+
+//Owns the GL objects of the renderer for as long as their source data lives.
+//Buffers are created on first use and uploaded again only when the generation of their source changes (see
+//ResourceGeneration.h), instead of being rebuilt every frame. Sphere mesh buffers are freed once the last sphere of
+//their level is gone. Programs get their per-frame uniforms uploaded once per frame, on first use in that frame.
+//Only needs a current OpenGL 3.3 context, no window or UI, so it also runs on an offscreen software context.
+//The context must still be current when the manager is destroyed.
+
+class GpuResourceManager
+{
+public:
+    GpuResourceManager() : frameIndex(0), uploads(0) {}
+    ~GpuResourceManager();
+
+    GpuResourceManager(const GpuResourceManager&) = delete;
+    GpuResourceManager& operator=(const GpuResourceManager&) = delete;
+
+    // Start a frame seen through view and projection, frees the buffers of meshes that no longer exist
+    void beginFrame(const glm::mat4& view, const glm::mat4& projection);
+    const FrameUniforms& frame() const { return frameUniforms; }
+
+    // Compile and link a program with view and projection uniforms, owned by the manager
+    GpuProgram& createProgram(const char* vertexShaderSource, const char* fragmentShaderSource);
+    // Bind a program, with this frame's view and projection
+    void useProgram(GpuProgram& program);
+
+    // Buffers of a shared sphere mesh, position only at attribute 0
+    const GpuMesh& sphereMesh(const std::shared_ptr<const SphereMesh>& mesh);
+    // Buffers of the wireframe cube of a world, position and color at attributes 0 and 1
+    const GpuMesh& worldBoundary(const WorldRenderData& world);
+
+    // Resources currently alive
+    int sphereMeshCount() const { return static_cast<int>(sphereMeshes.size()); }
+    int uploadCount() const { return uploads; } // Buffer uploads since creation
+
+private:
+    struct SphereMeshEntry {
+        GpuMesh gpu;
+        std::weak_ptr<const SphereMesh> source;
+    };
+
+    uint64_t frameIndex;
+    FrameUniforms frameUniforms;
+    std::vector<std::unique_ptr<GpuProgram>> programs; // Pointers stay valid as more are created
+    std::map<int, SphereMeshEntry> sphereMeshes;       // By complexity level
+    GpuMesh boundary;
+    int uploads;
+
+    void upload(GpuMesh& mesh, const void* vertices, size_t vertexBytes, const std::vector<int>& indices);
+    static void release(GpuMesh& mesh);
+};
@@ -0,0 +1,358 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include "Tracer.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static thread_local int currentWorkerIndex = 0;
+static thread_local int executeDepth = 0; // Jobs run from inside a job are already counted as busy
+static thread_local bool driverPinned = false; // This thread drove a job system that pinned it to core 0
+
+static int64_t nowNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#if defined(_WIN32)
+typedef DWORD_PTR ThreadAffinity;
+#elif defined(__linux__)
+typedef cpu_set_t ThreadAffinity;
+#else
+typedef int ThreadAffinity;
+#endif
+static thread_local ThreadAffinity driverAffinity; // Affinity of this thread before the job system pinned it
+
+// Bind the calling thread to one core, false (and left alone) if the core is beyond what the affinity mask holds
+// previous (if any) receives the affinity the thread had
+static bool pinCurrentThread(int core, ThreadAffinity* previous = nullptr) {
+#if defined(_WIN32)
+    if (core < 0 || core >= static_cast<int>(sizeof(DWORD_PTR) * 8))
+        return false;
+    DWORD_PTR old = SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << core);
+    if (previous)
+        *previous = old;
+    return old != 0;
+#elif defined(__linux__)
+    if (core < 0 || core >= CPU_SETSIZE)
+        return false;
+    if (previous)
+        pthread_getaffinity_np(pthread_self(), sizeof(*previous), previous);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)core;
+    (void)previous;
+    return false;
+#endif
+}
+
+static void restoreCurrentThread(const ThreadAffinity& affinity) {
+#if defined(_WIN32)
+    SetThreadAffinityMask(GetCurrentThread(), affinity);
+#elif defined(__linux__)
+    pthread_setaffinity_np(pthread_self(), sizeof(affinity), &affinity);
+#else
+    (void)affinity;
+#endif
+}
+
+//
+// TaskGraph
+//
+
+TaskGraph::TaskId TaskGraph::add(std::function<void(int worker)> task) {
+    std::unique_ptr<Node> node(new Node());
+    node->task = std::move(task);
+    node->graph = this;
+    nodes.push_back(std::move(node));
+    return static_cast<TaskId>(nodes.size() - 1);
+}
+
+void TaskGraph::precede(TaskId before, TaskId after) {
+    nodes[before]->successors.push_back(after);
+    nodes[after]->numPredecessors++;
+}
+
+void TaskGraph::runNode(void* data, int worker) {
+    Node* node = static_cast<Node*>(data);
+    node->task(worker);
+
+    // Release the successors whose last dependency this was
+    TaskGraph* graph = node->graph;
+    for (TaskId successor : node->successors) {
+        Node* next = graph->nodes[successor].get();
+        if (next->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            graph->jobSystem->submit(Job{ runNode, next, &graph->pending });
+    }
+}
+
+//
+// JobSystem
+//
+
+JobSystem::JobSystem(int numThreads, bool pinThreads) : pinThreads(pinThreads), stopping(false), queuedJobs(0), sleepingWorkers(0) {
+    start(numThreads);
+}
+
+JobSystem::~JobSystem() {
+    stop();
+}
+
+void JobSystem::restart(int numThreads, bool pin) {
+    stop();
+    pinThreads = pin;
+    start(numThreads);
+}
+
+int JobSystem::currentWorker() {
+    return currentWorkerIndex;
+}
+
+void JobSystem::start(int numThreads) {
+    if (numThreads <= 0)
+        numThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    stopping.store(false);
+    workers.clear();
+    for (int i = 0; i < numThreads; i++)
+        workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    resetStats();
+
+    for (int i = 1; i < numThreads; i++)
+        threads.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+void JobSystem::stop() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping.store(true);
+    }
+    wakeUp.notify_all();
+    for (std::thread& thread : threads)
+        thread.join();
+    threads.clear();
+}
+
+void JobSystem::submit(const Job& job) {
+    int index = currentWorkerIndex;
+    Worker& worker = *workers[index];
+    bool queued = false;
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tail - worker.head < static_cast<uint32_t>(dequeCapacity)) {
+            worker.deque[worker.tail % dequeCapacity] = job;
+            worker.tail++;
+            queuedJobs.fetch_add(1);
+            queued = true;
+        }
+    }
+    if (!queued) {
+        // Deque full, run the job right away
+        execute(index, job);
+        return;
+    }
+    if (sleepingWorkers.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wakeUp.notify_one();
+    }
+}
+
+bool JobSystem::findJob(int index, Job& job) {
+    // Newest job of our own deque first, it's the most likely to have its data in cache
+    {
+        Worker& own = *workers[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.tail != own.head) {
+            own.tail--;
+            job = own.deque[own.tail % dequeCapacity];
+            queuedJobs.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // Then the oldest job of another worker
+    int count = numWorkers();
+    for (int offset = 1; offset < count; offset++) {
+        Worker& victim = *workers[(index + offset) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.tail != victim.head) {
+            job = victim.deque[victim.head % dequeCapacity];
+            victim.head++;
+            queuedJobs.fetch_sub(1);
+            workers[index]->jobsStolen.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::execute(int index, const Job& job) {
+    Worker& worker = *workers[index];
+    int64_t start = executeDepth == 0 ? nowNanoseconds() : 0;
+    executeDepth++;
+    {
+        CDE_TRACE_SCOPE("Job");
+        job.function(job.data, index);
+    }
+    executeDepth--;
+    if (executeDepth == 0)
+        worker.busyNanoseconds.fetch_add(nowNanoseconds() - start, std::memory_order_relaxed);
+    worker.jobsExecuted.fetch_add(1, std::memory_order_relaxed);
+    if (job.pending)
+        job.pending->fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void JobSystem::wait(std::atomic<int>& pending) {
+    int index = currentWorkerIndex;
+    Worker& worker = *workers[index];
+    Job job;
+    CDE_TRACE_SCOPE("Wait"); // The time between the jobs run meanwhile is spent waiting for the other workers
+
+    // Idle is the time of the wait minus the jobs run meanwhile; inside a job the whole wait is already busy
+    bool counted = executeDepth == 0;
+    int64_t start = counted ? nowNanoseconds() : 0;
+    int64_t busyBefore = worker.busyNanoseconds.load(std::memory_order_relaxed);
+    while (pending.load(std::memory_order_acquire) > 0) {
+        if (findJob(index, job))
+            execute(index, job);
+        else
+            std::this_thread::yield();
+    }
+    if (counted) {
+        int64_t busy = worker.busyNanoseconds.load(std::memory_order_relaxed) - busyBefore;
+        worker.idleNanoseconds.fetch_add(std::max<int64_t>(0, nowNanoseconds() - start - busy), std::memory_order_relaxed);
+    }
+}
+
+void JobSystem::updateDriverAffinity() {
+    if (currentWorkerIndex != 0 || driverPinned == pinThreads)
+        return;
+    if (pinThreads)
+        driverPinned = pinCurrentThread(0, &driverAffinity);
+    else {
+        restoreCurrentThread(driverAffinity);
+        driverPinned = false;
+    }
+}
+
+void JobSystem::workerLoop(int index) {
+    currentWorkerIndex = index;
+    Worker& worker = *workers[index];
+#if CDE_ENABLE_TRACE
+    char threadName[32];
+    std::snprintf(threadName, sizeof(threadName), "Worker %d", index);
+    Tracer::setThreadName(threadName);
+#endif
+    if (pinThreads) {
+        unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+        pinCurrentThread(static_cast<int>(index % cores));
+    }
+
+    Job job;
+    while (!stopping.load()) {
+        // Spin a little before sleeping, parallel sections of a step come in quick succession
+        int64_t idleStart = nowNanoseconds();
+        bool found = false;
+        for (int attempt = 0; attempt < 64 && !found; attempt++) {
+            found = findJob(index, job);
+            if (!found)
+                std::this_thread::yield();
+        }
+        if (found) {
+            worker.idleNanoseconds.fetch_add(nowNanoseconds() - idleStart, std::memory_order_relaxed);
+            execute(index, job);
+            continue;
+        }
+
+        {
+            CDE_TRACE_SCOPE("Sleep");
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepingWorkers.fetch_add(1);
+            wakeUp.wait(lock, [this] { return queuedJobs.load() > 0 || stopping.load(); });
+            sleepingWorkers.fetch_sub(1);
+        }
+        worker.idleNanoseconds.fetch_add(nowNanoseconds() - idleStart, std::memory_order_relaxed);
+    }
+}
+
+void JobSystem::runChunks(void* data, int worker) {
+    ParallelFor& loop = *static_cast<ParallelFor*>(data);
+    for (;;) {
+        int chunk = loop.nextChunk.fetch_add(1, std::memory_order_relaxed);
+        if (chunk >= loop.numChunks)
+            return;
+        int chunkBegin = loop.begin + chunk * loop.grainSize;
+        int chunkEnd = loop.end - chunkBegin < loop.grainSize ? loop.end : chunkBegin + loop.grainSize;
+        CDE_TRACE_SCOPE("Chunk");
+        loop.invoke(loop.body, chunkBegin, chunkEnd, worker);
+    }
+}
+
+void JobSystem::runParallelFor(ParallelFor& loop) {
+    // Helpers take chunks from a shared counter, the idle workers steal them from our deque
+    int numHelpers = std::min(loop.numChunks, numWorkers()) - 1;
+    std::atomic<int> pending(numHelpers);
+    for (int i = 0; i < numHelpers; i++)
+        submit(Job{ runChunks, &loop, &pending });
+
+    runOwnChunks(loop);
+    wait(pending);
+}
+
+void JobSystem::runOwnChunks(ParallelFor& loop) {
+    int index = currentWorkerIndex;
+    int64_t start = executeDepth == 0 ? nowNanoseconds() : 0;
+    executeDepth++;
+    runChunks(&loop, index);
+    executeDepth--;
+    if (executeDepth == 0)
+        workers[index]->busyNanoseconds.fetch_add(nowNanoseconds() - start, std::memory_order_relaxed);
+}
+
+void JobSystem::run(TaskGraph& graph) {
+    if (graph.nodes.empty())
+        return;
+
+    updateDriverAffinity();
+    graph.jobSystem = this;
+    graph.pending.store(static_cast<int>(graph.nodes.size()));
+    for (auto& node : graph.nodes)
+        node->remaining.store(node->numPredecessors, std::memory_order_relaxed);
+    for (auto& node : graph.nodes) {
+        if (node->numPredecessors == 0)
+            submit(Job{ TaskGraph::runNode, node.get(), &graph.pending });
+    }
+    wait(graph.pending);
+}
+
+std::vector<WorkerStats> JobSystem::stats() const {
+    std::vector<WorkerStats> result;
+    for (const auto& worker : workers) {
+        WorkerStats stats;
+        stats.busySeconds = worker->busyNanoseconds.load() * 1e-9;
+        stats.idleSeconds = worker->idleNanoseconds.load() * 1e-9;
+        stats.jobsExecuted = worker->jobsExecuted.load();
+        stats.jobsStolen = worker->jobsStolen.load();
+        result.push_back(stats);
+    }
+    return result;
+}
+
+void JobSystem::resetStats() {
+    for (auto& worker : workers) {
+        worker->busyNanoseconds.store(0);
+        worker->idleNanoseconds.store(0);
+        worker->jobsExecuted.store(0);
+        worker->jobsStolen.store(0);
+    }
+}
@@ -0,0 +1,178 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The workers are over-aligned and allocated with new, only C++17 aligned new keeps them on their own cache lines
+#if !defined(__cpp_aligned_new)
+#error "JobSystem needs C++17 aligned new (/std:c++17 or -std=c++17)"
+#endif
+
+//A work-stealing thread pool for the simulation step.
+//Every worker has its own deque: it pushes and pops jobs at the back, idle workers steal from the front of the others.
+//Worker 0 is the thread driving the job system (the one calling stepSimulation), it runs jobs while it waits,
+//so numWorkers() threads take part in every parallel section. Only one thread should drive the job system at a time.
+//Queuing a job never allocates, a job is a function pointer and a data pointer that lives on the caller's stack.
+
+struct Job {
+    void (*function)(void* data, int worker);
+    void* data;
+    std::atomic<int>* pending; // Decremented once the job has run, may be null
+};
+
+// Time a worker spent running jobs vs. looking for or waiting for work since the last resetStats()
+// Idle time is only the time actually spent waiting: for worker 0 (the driving thread) the serial code between the
+// parallel sections, rendering or building a scene is neither busy nor idle
+struct WorkerStats {
+    double busySeconds;
+    double idleSeconds;
+    uint64_t jobsExecuted;
+    uint64_t jobsStolen;
+};
+
+class JobSystem;
+
+//A set of tasks with dependencies, built once and run as many times as needed.
+//A task starts when every task it depends on has finished, independent tasks run concurrently.
+class TaskGraph
+{
+public:
+    using TaskId = int;
+
+    TaskId add(std::function<void(int worker)> task);
+    // after will only start once before has finished
+    void precede(TaskId before, TaskId after);
+    size_t size() const { return nodes.size(); }
+
+private:
+    friend class JobSystem;
+
+    struct Node {
+        std::function<void(int worker)> task;
+        std::vector<TaskId> successors;
+        int numPredecessors = 0;
+        std::atomic<int> remaining{0}; // Predecessors still running in the current run
+        TaskGraph* graph = nullptr;
+    };
+
+    std::vector<std::unique_ptr<Node>> nodes;
+    std::atomic<int> pending{0}; // Tasks not finished in the current run
+    JobSystem* jobSystem = nullptr;
+
+    static void runNode(void* data, int worker);
+};
+
+class JobSystem
+{
+public:
+    // numThreads counts the calling thread, 0 uses one thread per hardware thread.
+    // With pinThreads every worker is bound to one core, worker i to core i (modulo the cores). Worker 0 is the
+    // thread driving the job system, it is pinned at its first parallel section and gets its previous affinity
+    // back at its first parallel section of a job system that doesn't pin.
+    explicit JobSystem(int numThreads = 0, bool pinThreads = false);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Stop the workers and start new ones, must not be called while jobs are in flight
+    void restart(int numThreads, bool pinThreads);
+
+    int numWorkers() const { return static_cast<int>(workers.size()); }
+    bool threadsPinned() const { return pinThreads; }
+
+    // Index of the worker running the caller, 0 for the driving thread
+    static int currentWorker();
+
+    // Queue a job on the current worker's deque
+    void submit(const Job& job);
+    // Run jobs until pending drops to 0
+    void wait(std::atomic<int>& pending);
+
+    // Call body(chunkBegin, chunkEnd, worker) over [begin, end) split in chunks of grainSize, and wait for all of them
+    // The chunk boundaries only depend on grainSize, so which worker runs a chunk never changes the result
+    template <typename Body>
+    void parallelFor(int begin, int end, int grainSize, const Body& body);
+
+    // Run every task of the graph and wait for them
+    void run(TaskGraph& graph);
+
+    std::vector<WorkerStats> stats() const;
+    void resetStats();
+
+private:
+    struct ParallelFor {
+        void (*invoke)(const void* body, int begin, int end, int worker);
+        const void* body;
+        int begin;
+        int end;
+        int grainSize;
+        int numChunks;
+        std::atomic<int> nextChunk;
+    };
+
+    static constexpr int dequeCapacity = 1024;
+
+    // One per worker, on its own cache lines so the workers don't false share (allocated with aligned new)
+    struct alignas(64) Worker {
+        std::mutex mutex; // Guards the deque, held only to push, pop or steal one job
+        Job deque[dequeCapacity];
+        uint32_t head = 0; // Next job to steal
+        uint32_t tail = 0; // Next free slot
+        std::atomic<int64_t> busyNanoseconds{0};
+        std::atomic<int64_t> idleNanoseconds{0}; // Looking for a job, sleeping, or waiting for the others in wait()
+        std::atomic<uint64_t> jobsExecuted{0};
+        std::atomic<uint64_t> jobsStolen{0};
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    bool pinThreads;
+    std::atomic<bool> stopping;
+    std::atomic<int> queuedJobs;
+    std::atomic<int> sleepingWorkers;
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+
+    void start(int numThreads);
+    void stop();
+    void workerLoop(int index);
+    bool findJob(int index, Job& job);
+    void execute(int index, const Job& job);
+    void runParallelFor(ParallelFor& loop);
+    void runOwnChunks(ParallelFor& loop); // Take chunks on the calling thread until none is left, counted as busy
+    void updateDriverAffinity(); // Pin or unpin the calling thread, worker 0, to match pinThreads
+    static void runChunks(void* data, int worker);
+};
+
+template <typename Body>
+void JobSystem::parallelFor(int begin, int end, int grainSize, const Body& body) {
+    if (end <= begin)
+        return;
+    if (grainSize < 1)
+        grainSize = 1;
+
+    updateDriverAffinity();
+    int numChunks = (end - begin + grainSize - 1) / grainSize;
+
+    ParallelFor loop;
+    loop.invoke = [](const void* data, int chunkBegin, int chunkEnd, int worker) {
+        (*static_cast<const Body*>(data))(chunkBegin, chunkEnd, worker);
+    };
+    loop.body = &body;
+    loop.begin = begin;
+    loop.end = end;
+    loop.grainSize = grainSize;
+    loop.numChunks = numChunks;
+    loop.nextChunk.store(0, std::memory_order_relaxed);
+    if (numChunks == 1 || numWorkers() == 1)
+        runOwnChunks(loop); // Nothing to share, the calling thread runs every chunk
+    else
+        runParallelFor(loop);
+}
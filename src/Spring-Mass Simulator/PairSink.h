@@ -0,0 +1,65 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "FrameArena.h"
+#include "JobSystem.h"
+
+//Output path of a stage producing sphere pairs on several workers.
+//Every worker appends to its own buffer, on its own cache line and in its own frame arena, so producing pairs
+//needs no shared push_back and no lock. merge() then concatenates the buffers: a prefix sum of their sizes gives
+//every buffer its offset in the output, and the copies run in parallel.
+//Which worker found which pair depends on scheduling, consumers that need a fixed order sort the merged keys.
+
+class PairSink
+{
+public:
+    // Start collecting for one step, with one empty buffer per worker in that worker's arena
+    void begin(FrameArenaPool& arenas, int numWorkers) {
+        if (static_cast<int>(buffers.size()) != numWorkers) {
+            buffers.resize(numWorkers);
+            offsets.resize(numWorkers + 1);
+        }
+        for (int worker = 0; worker < numWorkers; worker++)
+            buffers[worker].keys = ArenaVector<uint64_t>(ArenaAllocator<uint64_t>(&arenas.arena(worker)));
+    }
+
+    // Append a pair key, only the given worker may append to its buffer
+    void push(int worker, uint64_t key) {
+        buffers[worker].keys.push_back(key);
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (const Buffer& buffer : buffers) total += buffer.keys.size();
+        return total;
+    }
+
+    // Concatenate every buffer into output, in worker order
+    void merge(ArenaVector<uint64_t>& output, JobSystem* jobs) {
+        const int numBuffers = static_cast<int>(buffers.size());
+        offsets[0] = 0;
+        for (int worker = 0; worker < numBuffers; worker++)
+            offsets[worker + 1] = offsets[worker] + buffers[worker].keys.size();
+        output.resize(offsets[numBuffers]);
+
+        auto copy = [&](int begin, int end, int) {
+            for (int worker = begin; worker < end; worker++)
+                std::copy(buffers[worker].keys.begin(), buffers[worker].keys.end(), output.begin() + offsets[worker]);
+        };
+        if (jobs)
+            jobs->parallelFor(0, numBuffers, 1, copy);
+        else
+            copy(0, numBuffers, 0);
+    }
+
+private:
+    // Its own cache line per worker: the vector gets the alignment from C++17 aligned new (JobSystem.h requires it)
+    struct alignas(64) Buffer {
+        ArenaVector<uint64_t> keys;
+    };
+    static_assert(alignof(Buffer) == 64 && sizeof(Buffer) % 64 == 0, "Every buffer should fill whole cache lines");
+
+    std::vector<Buffer> buffers;
+    std::vector<size_t> offsets;
+};
@@ -4,243 +4,646 @@
 #include <vector>
 #include <string>
 #include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#ifdef _MSC_VER
+#include <malloc.h> // _aligned_malloc
+#endif
 #include "SphereBV.h"
-#include "CollisionDetection.h"
-#include "Utils.h"
-
-// Function to create spheres with specified parameters
-void createSpheres(SphereBV* spheres, int numSpheres, int complexity, float radius, float velocity, float mass, float worldSize) {
-    Utils utils;
-    for (int i = 0; i < numSpheres; i++) {
-        // Random center within cubic worldsize (default world centered at origin)
-        float minBoundary = -worldSize + radius;
-        float maxBoundary = worldSize - radius;
-        glm::vec3 center = glm::vec3(
-            utils.randomFloat(minBoundary, maxBoundary),
-            utils.randomFloat(minBoundary, maxBoundary),
-            utils.randomFloat(minBoundary, maxBoundary)
-        );
-
-        // Generate random velocity in the given range
-        glm::vec3 vel = glm::vec3(
-            utils.randomFloat(-velocity, velocity),
-            utils.randomFloat(-velocity, velocity),
-            utils.randomFloat(-velocity, velocity)
-        );
-
-        // Generate color based on radius, mass, and velocity
-        glm::vec3 color;
-        color.r = utils.randomFloat(0.0f, 1.0f);
-        color.g = utils.randomFloat(0.0f, 1.0f);
-        color.b = utils.randomFloat(0.0f, 1.0f);
-
-        // Create the sphere
-        spheres[i] = SphereBV(center, radius, vel, mass, complexity, color, i);
+#include "SphereStore.h"
+#include "CounterRng.h"
+#include "SimdKernels.h"
+#include "JobSystem.h"
+#include "SimulatorWorld.h"
+#include "Scenario.h"
+#include "PerformanceAnalysis.h"
+
+// Allocation counter: every global operator new goes through here (plain, nothrow and, from C++17, over-aligned), so
+// the benchmark can check that a steady-state collision step does no heap allocation
+static std::atomic<size_t> heapAllocationCount(0);
+
+// Workers of every benchmark world, resolved by runPerformanceAnalysis (0 threads means every hardware thread)
+static int benchmarkWorkers = 0;
+static bool benchmarkPinned = false;
+
+// Busy and idle time of the workers, summed over the job systems of every benchmark world
+static std::vector<WorkerStats> benchmarkWorkerStats;
+
+// Options of the current run, rerunning with the seed of a CSV row rebuilds the exact same spheres
+static BenchmarkOptions benchmarkOptions = {};
+
+// Counted allocation, null when out of memory
+void* countedAllocation(size_t size) {
+    heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new(size_t size) {
+    if (void* p = countedAllocation(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return countedAllocation(size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return countedAllocation(size);
+}
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+#if __cpp_aligned_new
+// Over-aligned types (alignas beyond the default, e.g. the job system's workers and the pair buffers) come through here
+void* countedAlignedAllocation(size_t size, std::align_val_t alignment) {
+    heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    size_t align = static_cast<size_t>(alignment);
+    size = (size + align - 1) / align * align; // aligned_alloc wants a multiple of the alignment
+    if (size == 0) size = align;
+#ifdef _MSC_VER
+    return _aligned_malloc(size, align);
+#else
+    return std::aligned_alloc(align, size);
+#endif
+}
+
+void freeAligned(void* p) {
+#ifdef _MSC_VER
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    if (void* p = countedAlignedAllocation(size, alignment)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return countedAlignedAllocation(size, alignment);
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return countedAlignedAllocation(size, alignment);
+}
+void operator delete(void* p, std::align_val_t) noexcept {
+    freeAligned(p);
+}
+void operator delete[](void* p, std::align_val_t) noexcept {
+    freeAligned(p);
+}
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    freeAligned(p);
+}
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+    freeAligned(p);
+}
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    freeAligned(p);
+}
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    freeAligned(p);
+}
+#endif
+
+// One scene of an experiment, run once per method
+struct BenchmarkScene {
+    int scenario; // Generator of the scene, see scenarioAt
+    int numSpheres;
+    float minRadius;
+    float radius; // Largest radius, every sphere has it when minRadius is the same
+    float velocity; // Velocity components are in [-velocity, velocity]
+    float mass;
+    float worldSize;
+};
+
+// Settings of a world holding the scene, stepped with method
+// The world is headless: the benchmark never renders so the broad phase keeps no spatial index for culling
+WorldSettings sceneSettings(const BenchmarkScene& scene, int method) {
+    WorldSettings settings = {};
+    settings.numSpheres = scene.numSpheres;
+    settings.minRadius = scene.minRadius;
+    settings.maxRadius = scene.radius;
+    settings.minVelocity = -scene.velocity;
+    settings.maxVelocity = scene.velocity;
+    settings.minMass = scene.mass;
+    settings.maxMass = scene.mass;
+    settings.worldSize = scene.worldSize;
+    settings.seed = benchmarkOptions.seed;
+    settings.method = method;
+    settings.numThreads = benchmarkWorkers;
+    settings.pinThreads = benchmarkPinned;
+    settings.headless = true;
+    settings.scenario = scene.scenario;
+    return settings;
+}
+
+// Phases timed by the benchmark, total is broad + narrow + handle of the same step
+enum BenchmarkPhase { PhaseBroad, PhaseNarrow, PhaseHandle, PhaseIntegrate, PhaseTotal, PhaseCount };
+const char* const phaseNames[PhaseCount] = { "Broad", "Narrow", "Handle", "Integrate", "Total" };
+
+// Distribution of the times of one phase over the measured steps, in nanoseconds
+struct PhaseStats {
+    long long min;
+    long long median;
+    long long p95;
+    long long p99;
+    long long max;
+    double mean;
+};
+
+// Nearest-rank percentile of sorted samples
+template <typename T>
+T percentile(const std::vector<T>& sorted, double p) {
+    if (sorted.empty()) return T();
+    size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// Sorts the samples
+PhaseStats summarize(std::vector<long long>& samples) {
+    PhaseStats stats = {};
+    if (samples.empty()) return stats;
+    std::sort(samples.begin(), samples.end());
+    stats.min = samples.front();
+    stats.median = percentile(samples, 0.5);
+    stats.p95 = percentile(samples, 0.95);
+    stats.p99 = percentile(samples, 0.99);
+    stats.max = samples.back();
+    double sum = 0.0;
+    for (long long sample : samples) sum += static_cast<double>(sample);
+    stats.mean = sum / samples.size();
+    return stats;
+}
+
+// Measured steps of one scene and method
+struct BenchmarkResult {
+    BenchmarkScene scene;
+    int method;
+    PhaseStats phases[PhaseCount];
+    int potentialCollisions; // Median over the measured steps
+    int actualCollisions;    // Median over the measured steps
+    long long gjkIterations; // Median over the measured steps, of every pair of the narrow phase
+    int wallBounces;         // Median over the measured steps
+    size_t steadyStateAllocations;
+    size_t arenaHighWater;
+};
+
+const char* methodName(int method) {
+    if (method == 0) return "Sweep_and_Prune";
+    if (method == 1) return "Brute_Force";
+    return "Grid";
+}
+
+// Steps a world of the scene with one method: warmup steps first, then the phase times and counters the world records
+// for each measured step (see StepStats.h) are kept. The step is SimulatorWorld::stepSimulation itself, so the
+// benchmark measures exactly what the simulator runs, integration and frame-to-frame coherence included
+BenchmarkResult measurePerformance(const BenchmarkScene& scene, int method) {
+    SimulatorWorld world(sceneSettings(scene, method));
+
+    // Sized up front, so the only allocations counted are the ones of the steps
+    const int steps = benchmarkOptions.warmupSteps + benchmarkOptions.measuredSteps;
+    std::vector<long long> samples[PhaseCount];
+    for (std::vector<long long>& phase : samples) phase.reserve(benchmarkOptions.measuredSteps);
+    std::vector<int> potentialCounts;
+    std::vector<int> actualCounts;
+    std::vector<long long> gjkCounts;
+    std::vector<int> bounceCounts;
+    potentialCounts.reserve(benchmarkOptions.measuredSteps);
+    actualCounts.reserve(benchmarkOptions.measuredSteps);
+    gjkCounts.reserve(benchmarkOptions.measuredSteps);
+    bounceCounts.reserve(benchmarkOptions.measuredSteps);
+
+    // The warmup sized the arenas, the measured steps should not touch the heap anymore.
+    // With several workers a worker arena can still grow once when a worker takes a larger share than ever before.
+    size_t allocationsBefore = heapAllocationCount.load(std::memory_order_relaxed);
+    for (int step = 0; step < steps; step++) {
+        if (step == benchmarkOptions.warmupSteps)
+            allocationsBefore = heapAllocationCount.load(std::memory_order_relaxed);
+        world.stepSimulation(benchmarkOptions.stepTime);
+        if (step < benchmarkOptions.warmupSteps)
+            continue;
+
+        StepStats stats = world.stats.last();
+        samples[PhaseBroad].push_back(stats.broadNs);
+        samples[PhaseNarrow].push_back(stats.narrowNs);
+        samples[PhaseHandle].push_back(stats.responseNs);
+        samples[PhaseIntegrate].push_back(stats.integrationNs);
+        samples[PhaseTotal].push_back(stats.broadNs + stats.narrowNs + stats.responseNs);
+        potentialCounts.push_back(static_cast<int>(stats.candidatePairs));
+        actualCounts.push_back(static_cast<int>(stats.confirmedPairs));
+        gjkCounts.push_back(static_cast<long long>(stats.gjkIterations));
+        bounceCounts.push_back(static_cast<int>(stats.wallBounces));
+    }
+    size_t steadyStateAllocations = heapAllocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+
+    std::vector<WorkerStats> workerStats = world.jobSystem.stats();
+    if (benchmarkWorkerStats.size() < workerStats.size())
+        benchmarkWorkerStats.resize(workerStats.size(), WorkerStats());
+    for (size_t i = 0; i < workerStats.size(); i++) {
+        benchmarkWorkerStats[i].busySeconds += workerStats[i].busySeconds;
+        benchmarkWorkerStats[i].idleSeconds += workerStats[i].idleSeconds;
+        benchmarkWorkerStats[i].jobsExecuted += workerStats[i].jobsExecuted;
+        benchmarkWorkerStats[i].jobsStolen += workerStats[i].jobsStolen;
+    }
+
+    BenchmarkResult result = {};
+    result.scene = scene;
+    result.method = method;
+    result.steadyStateAllocations = steadyStateAllocations;
+    result.arenaHighWater = world.frameArenas.totalHighWaterMark();
+    for (int phase = 0; phase < PhaseCount; phase++)
+        result.phases[phase] = summarize(samples[phase]);
+    std::sort(potentialCounts.begin(), potentialCounts.end());
+    std::sort(actualCounts.begin(), actualCounts.end());
+    result.potentialCollisions = percentile(potentialCounts, 0.5);
+    result.actualCollisions = percentile(actualCounts, 0.5);
+    std::sort(gjkCounts.begin(), gjkCounts.end());
+    std::sort(bounceCounts.begin(), bounceCounts.end());
+    result.gjkIterations = percentile(gjkCounts, 0.5);
+    result.wallBounces = percentile(bounceCounts, 0.5);
+
+    if (result.steadyStateAllocations != 0) {
+        std::cout << "Warning: " << result.steadyStateAllocations << " heap allocations in "
+                  << benchmarkOptions.measuredSteps << " steady-state steps" << std::endl;
     }
+    return result;
 }
 
-// Function to measure collision detection performance
-void measurePerformance(int numSpheres, int complexity, float radius, float velocity, 
-                        float mass, float worldSize, int method, std::ofstream& outputFile) {
-    
-    // Create spheres with specified parameters
-    SphereBV* spheres = new SphereBV[numSpheres];
-    createSpheres(spheres, numSpheres, complexity, radius, velocity, mass, worldSize);
+// Header of the CSV: the columns of the single-step benchmark first, the times now being medians, then the step
+// counts, the integration and the percentiles of every phase
+void writeCsvHeader(std::ofstream& outputFile) {
+    outputFile << "NumSpheres,Radius,Velocity,Mass,WorldSize,Method,"
+               << "BroadTime_ms,NarrowTime_ms,HandleTime_ms,TotalTime_ms,"
+               << "PotentialCollisions,ActualCollisions,SteadyStateAllocations,ArenaHighWater_bytes,SimdPath,Seed,"
+               << "WarmupSteps,MeasuredSteps,IntegrateTime_ms";
+    for (int phase = 0; phase < PhaseCount; phase++)
+        outputFile << "," << phaseNames[phase] << "_p95_ms," << phaseNames[phase] << "_p99_ms";
+    outputFile << ",Scenario,MinRadius,GjkIterations,WallBounces" << std::endl;
+}
 
-    // Vector to store collision pairs
-    std::vector<std::pair<SphereBV*, SphereBV*>> collisionPairs;
-    
-    // Create collision detection object
-    CollisionDetection collisionDetection(spheres, numSpheres, worldSize, &collisionPairs, method);
-    
-    // Timing variables
-    auto startBroad = std::chrono::high_resolution_clock::now();
-    auto endBroad = std::chrono::high_resolution_clock::now();
-    auto startNarrow = std::chrono::high_resolution_clock::now();
-    auto endNarrow = std::chrono::high_resolution_clock::now();
-    auto startHandle = std::chrono::high_resolution_clock::now();
-    auto endHandle = std::chrono::high_resolution_clock::now();
-
-    // Timing for broad phase
-    startBroad = std::chrono::high_resolution_clock::now();
-    collisionDetection.broadCollisionDetection();
-    endBroad = std::chrono::high_resolution_clock::now();
-
-    // Count potential collisions after broad phase
-    int potentialCollisions = collisionPairs.size();
-
-    // Timing for narrow phase
-    startNarrow = std::chrono::high_resolution_clock::now();
-    collisionDetection.narrowCollisionDetection();
-    endNarrow = std::chrono::high_resolution_clock::now();
-
-    // Count actual collisions after narrow phase
-    int actualCollisions = collisionPairs.size();
-
-    // Timing for collision handling
-    startHandle = std::chrono::high_resolution_clock::now();
-    collisionDetection.handleCollision();
-    endHandle = std::chrono::high_resolution_clock::now();
-
-    // Calculate durations in microseconds
-    auto broadDuration = std::chrono::duration_cast<std::chrono::microseconds>(endBroad - startBroad).count();
-    auto narrowDuration = std::chrono::duration_cast<std::chrono::microseconds>(endNarrow - startNarrow).count();
-    auto handleDuration = std::chrono::duration_cast<std::chrono::microseconds>(endHandle - startHandle).count();
-    auto totalDuration = broadDuration + narrowDuration + handleDuration;
-
-    // Convert microseconds to milliseconds for output
-    double broadMs = broadDuration / 1000.0;
-    double narrowMs = narrowDuration / 1000.0;
-    double handleMs = handleDuration / 1000.0;
-    double totalMs = totalDuration / 1000.0;
-
-    // Get method name
-    std::string methodName;
-    if (method == 0) methodName = "Sweep_and_Prune";
-    else if (method == 1) methodName = "Brute_Force";
-    else methodName = "Grid";
-
-    // Output to file: numSpheres,complexity,radius,velocity,mass,worldSize,method,
-    // broadTime(ms),narrowTime(ms),handleTime(ms),totalTime(ms),potentialCollisions,actualCollisions
-    outputFile << numSpheres << ","
-               << complexity << ","
-               << radius << ","
-               << velocity << ","
-               << mass << ","
-               << worldSize << ","
-               << methodName << ","
-               << std::fixed << std::setprecision(3) << broadMs << ","
-               << std::fixed << std::setprecision(3) << narrowMs << ","
-               << std::fixed << std::setprecision(3) << handleMs << ","
-               << std::fixed << std::setprecision(3) << totalMs << ","
-               << potentialCollisions << ","
-               << actualCollisions << std::endl;
-
-    // Clean up
-    for (int i = 0; i < numSpheres; i++) {
-        if (spheres[i].mesh) {
-            delete spheres[i].mesh;
-            spheres[i].mesh = nullptr;
+void writeCsvRow(const BenchmarkResult& result, std::ofstream& outputFile) {
+    const BenchmarkScene& scene = result.scene;
+    outputFile << scene.numSpheres << ","
+               << scene.radius << ","
+               << scene.velocity << ","
+               << scene.mass << ","
+               << scene.worldSize << ","
+               << methodName(result.method) << ","
+               << std::fixed << std::setprecision(6)
+               << StepStats::toMs(result.phases[PhaseBroad].median) << ","
+               << StepStats::toMs(result.phases[PhaseNarrow].median) << ","
+               << StepStats::toMs(result.phases[PhaseHandle].median) << ","
+               << StepStats::toMs(result.phases[PhaseTotal].median) << ","
+               << std::defaultfloat
+               << result.potentialCollisions << ","
+               << result.actualCollisions << ","
+               << result.steadyStateAllocations << ","
+               << result.arenaHighWater << ","
+               << simdPathName(simdKernels().path) << ","
+               << benchmarkOptions.seed << ","
+               << benchmarkOptions.warmupSteps << ","
+               << benchmarkOptions.measuredSteps << ","
+               << std::fixed << std::setprecision(6)
+               << StepStats::toMs(result.phases[PhaseIntegrate].median);
+    for (int phase = 0; phase < PhaseCount; phase++)
+        outputFile << "," << StepStats::toMs(result.phases[phase].p95) << "," << StepStats::toMs(result.phases[phase].p99);
+    outputFile << std::defaultfloat << "," << scenarioAt(scene.scenario).name << "," << scene.minRadius
+               << "," << result.gjkIterations << "," << result.wallBounces << std::endl;
+}
+
+// Same results as the CSV, with the whole distribution of every phase, in nanoseconds
+void writeJson(const std::vector<BenchmarkResult>& results, bool simdParity, const char* path) {
+    std::ofstream outputFile(path);
+    outputFile << "{\n"
+               << "  \"seed\": " << benchmarkOptions.seed << ",\n"
+               << "  \"simdPath\": \"" << simdPathName(simdKernels().path) << "\",\n"
+               << "  \"simdParity\": " << (simdParity ? "true" : "false") << ",\n"
+               << "  \"workers\": " << benchmarkWorkers << ",\n"
+               << "  \"pinnedThreads\": " << (benchmarkPinned ? "true" : "false") << ",\n"
+               << "  \"warmupSteps\": " << benchmarkOptions.warmupSteps << ",\n"
+               << "  \"measuredSteps\": " << benchmarkOptions.measuredSteps << ",\n"
+               << "  \"stepTime\": " << benchmarkOptions.stepTime << ",\n"
+               << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult& result = results[i];
+        const BenchmarkScene& scene = result.scene;
+        outputFile << (i > 0 ? "," : "") << "\n    {\n"
+                   << "      \"scenario\": \"" << scenarioAt(scene.scenario).name << "\",\n"
+                   << "      \"numSpheres\": " << scene.numSpheres << ",\n"
+                   << "      \"minRadius\": " << scene.minRadius << ",\n"
+                   << "      \"radius\": " << scene.radius << ",\n"
+                   << "      \"velocity\": " << scene.velocity << ",\n"
+                   << "      \"mass\": " << scene.mass << ",\n"
+                   << "      \"worldSize\": " << scene.worldSize << ",\n"
+                   << "      \"method\": \"" << methodName(result.method) << "\",\n"
+                   << "      \"potentialCollisions\": " << result.potentialCollisions << ",\n"
+                   << "      \"actualCollisions\": " << result.actualCollisions << ",\n"
+                   << "      \"gjkIterations\": " << result.gjkIterations << ",\n"
+                   << "      \"wallBounces\": " << result.wallBounces << ",\n"
+                   << "      \"steadyStateAllocations\": " << result.steadyStateAllocations << ",\n"
+                   << "      \"arenaHighWaterBytes\": " << result.arenaHighWater << ",\n"
+                   << "      \"phases\": {";
+        for (int phase = 0; phase < PhaseCount; phase++) {
+            const PhaseStats& stats = result.phases[phase];
+            outputFile << (phase > 0 ? "," : "") << "\n        \"" << phaseNames[phase] << "\": {"
+                       << "\"min_ns\": " << stats.min
+                       << ", \"median_ns\": " << stats.median
+                       << ", \"p95_ns\": " << stats.p95
+                       << ", \"p99_ns\": " << stats.p99
+                       << ", \"max_ns\": " << stats.max
+                       << ", \"mean_ns\": " << std::fixed << std::setprecision(1) << stats.mean << std::defaultfloat << "}";
         }
+        outputFile << "\n      }\n    }";
+    }
+    outputFile << "\n  ]\n}" << std::endl;
+}
+
+// Run the scene with every method, the same seed gives sweep and prune and brute force the same spheres
+void runScene(const BenchmarkScene& scene, std::vector<BenchmarkResult>& results, std::ofstream& outputFile) {
+    for (int method : {0, 1}) {
+        BenchmarkResult result = measurePerformance(scene, method);
+        writeCsvRow(result, outputFile);
+        results.push_back(result);
+
+        std::cout << "Completed test: " << scenarioAt(scene.scenario).name << ", " << scene.numSpheres << " spheres"
+                  << ", radius " << scene.radius << ", method " << methodName(method)
+                  << ", velocity " << scene.velocity << ", mass " << scene.mass
+                  << std::fixed << std::setprecision(3)
+                  << ", broad median " << StepStats::toMs(result.phases[PhaseBroad].median) << " ms"
+                  << " (p99 " << StepStats::toMs(result.phases[PhaseBroad].p99) << ")"
+                  << ", narrow median " << StepStats::toMs(result.phases[PhaseNarrow].median) << " ms"
+                  << ", handle median " << StepStats::toMs(result.phases[PhaseHandle].median) << " ms"
+                  << ", total median " << StepStats::toMs(result.phases[PhaseTotal].median) << " ms"
+                  << " (p95 " << StepStats::toMs(result.phases[PhaseTotal].p95)
+                  << ", p99 " << StepStats::toMs(result.phases[PhaseTotal].p99) << ")"
+                  << std::defaultfloat
+                  << ", potential collisions " << result.potentialCollisions
+                  << ", actual collisions " << result.actualCollisions
+                  << ", arena high-water mark " << result.arenaHighWater << " bytes" << std::endl;
     }
-    delete[] spheres;
+}
+
+// Function to measure how long building a headless world takes
+void measureWorldBuild(int numSpheres, std::ofstream& outputFile) {
+    WorldSettings settings = {};
+    settings.numSpheres = numSpheres;
+    settings.minRadius = 0.2f;
+    settings.maxRadius = 1.0f;
+    settings.minVelocity = -5.0f;
+    settings.maxVelocity = 5.0f;
+    settings.minMass = 0.5f;
+    settings.maxMass = 10.0f;
+    settings.worldSize = 20.0f * std::cbrt(numSpheres / 1000.0f); // Same density for every count
+    settings.seed = benchmarkOptions.seed;
+    settings.method = 0;
+    settings.numThreads = benchmarkWorkers;
+    settings.pinThreads = benchmarkPinned;
+    settings.headless = true;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::unique_ptr<SimulatorWorld> world(new SimulatorWorld(settings));
+    auto end = std::chrono::high_resolution_clock::now();
+    double buildMs = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+
+    // Output to file: numSpheres,workers,buildTime(ms),seed
+    outputFile << numSpheres << ","
+               << world->jobSystem.numWorkers() << ","
+               << std::fixed << std::setprecision(3) << buildMs << ","
+               << benchmarkOptions.seed << std::endl;
 
-    std::cout << "Completed test: " << numSpheres << " spheres, complexity " << complexity 
-              << ", radius " << radius << ", method " << methodName 
-                << ", velocity " << velocity << ", mass " << mass
-              << ", broad Collisions Detection Time " << broadMs << " ms"
-              << ", narrow Collisions Detection Time " << narrowMs << " ms"
-                << ", handle Collisions Time " << handleMs << " ms"
-                
-              << ", time " << totalMs << " ms" 
-                << ", potential collisions " << potentialCollisions 
-                    << ", actual collisions " << actualCollisions << std::endl;
+    std::cout << "Built world: " << numSpheres << " spheres, " << world->jobSystem.numWorkers()
+              << " workers, time " << buildMs << " ms" << std::endl;
+}
+
+// Print the memory footprint per sphere of the previous AoS SphereBV and of the physics store
+void reportMemoryFootprint() {
+    // sizeof(SphereBV) on x64 before the split: center, radius, mesh pointer, mat4 transform, velocity,
+    // mass, complexity level, color and id, padded to the pointer alignment
+    const size_t legacySphereBytes = 128;
+    const size_t physicsBytes = SphereStore::bytesPerSphere();
+
+    std::cout << "Memory per sphere before split: " << legacySphereBytes << " bytes (+ mesh)" << std::endl;
+    std::cout << "Memory per sphere after split: " << physicsBytes
+              << " bytes physics, the render data lives in the application" << std::endl;
+}
 
+// Index of the first element that differs in its bits, -1 if there is none
+int firstDifference(const std::vector<float>& a, const std::vector<float>& b) {
+    if (a.size() != b.size())
+        return 0;
+    for (size_t i = 0; i < a.size(); i++)
+        if (std::memcmp(&a[i], &b[i], sizeof(float)) != 0) return static_cast<int>(i);
+    return -1;
+}
+
+// The spheres at rest against the walls, their centers one float below, at or above the limit worldSize - radius
+// A scene seldom puts a sphere within a rounding error of a wall, this is where the kernels' tests can disagree
+SphereStore wallSpheres(const SphereStore& spheres, float worldSize) {
+    SphereStore wall = spheres;
+    for (int i = 0; i < wall.size(); i++) {
+        float limit = worldSize - wall.radius[i];
+        float center = (i % 3 == 0) ? std::nextafter(limit, 0.0f) : ((i % 3 == 1) ? limit : std::nextafter(limit, worldSize));
+        wall.centerX[i] = center;
+        wall.centerY[i] = -center;
+        wall.centerZ[i] = (i & 1) ? center : -center;
+        wall.velocityX[i] = 0.0f;
+        wall.velocityY[i] = 0.0f;
+        wall.velocityZ[i] = 0.0f;
+    }
+    return wall;
 }
 
+bool checkSimdParity(const WorldSettings& settings, int steps, float stepTime) {
+    const SimdPath selected = simdKernels().path;
+    WorldSettings headless = settings;
+    headless.headless = true;
 
+    SphereStore reference;
+    SphereStore wallReference;
+    bool identical = true;
+    for (SimdPath path : { SimdPath::Scalar, SimdPath::SSE2, SimdPath::AVX2, SimdPath::AVX512 }) {
+        if (!isSimdPathSupported(path))
+            continue;
+        selectSimdPath(path);
+        SimulatorWorld world(headless);
+        SphereStore wall = wallSpheres(world.spheres, settings.worldSize);
+        simdKernels().integrate(wall, 0, wall.size(), stepTime, settings.worldSize);
+        for (int step = 0; step < steps; step++)
+            world.stepSimulation(stepTime);
+        if (path == SimdPath::Scalar) {
+            reference = world.spheres;
+            wallReference = wall;
+            continue;
+        }
+
+        struct Field { const char* name; const std::vector<float>& value; const std::vector<float>& expected; };
+        const Field fields[] = {
+            { "centerX", world.spheres.centerX, reference.centerX }, { "centerY", world.spheres.centerY, reference.centerY },
+            { "centerZ", world.spheres.centerZ, reference.centerZ }, { "radius", world.spheres.radius, reference.radius },
+            { "velocityX", world.spheres.velocityX, reference.velocityX }, { "velocityY", world.spheres.velocityY, reference.velocityY },
+            { "velocityZ", world.spheres.velocityZ, reference.velocityZ }, { "inverseMass", world.spheres.inverseMass, reference.inverseMass },
+            { "wall centerX", wall.centerX, wallReference.centerX }, { "wall centerY", wall.centerY, wallReference.centerY },
+            { "wall centerZ", wall.centerZ, wallReference.centerZ }, { "wall velocityX", wall.velocityX, wallReference.velocityX },
+            { "wall velocityY", wall.velocityY, wallReference.velocityY }, { "wall velocityZ", wall.velocityZ, wallReference.velocityZ },
+        };
+        bool same = true;
+        for (const Field& field : fields) {
+            int i = firstDifference(field.value, field.expected);
+            if (i < 0)
+                continue;
+            std::cout << "SIMD parity: " << simdPathName(path) << " differs from Scalar in " << field.name << "[" << i << "]";
+            if (i < static_cast<int>(field.value.size()) && i < static_cast<int>(field.expected.size()))
+                std::cout << std::setprecision(9) << " (" << field.value[i] << " vs " << field.expected[i] << ")" << std::defaultfloat;
+            std::cout << std::endl;
+            same = false;
+        }
+        if (same)
+            std::cout << "SIMD parity: " << simdPathName(path) << " matches Scalar after " << steps << " steps and at the walls" << std::endl;
+        identical = identical && same;
+    }
+    selectSimdPath(selected);
+    return identical;
+}
+
+// Busy vs. idle time of every worker over the benchmark runs, a low busy share on the extra workers means poor scaling
+void reportWorkerStats(const std::vector<WorkerStats>& stats) {
+    std::cout << "\n=== Worker utilization ===" << std::endl;
+    for (size_t i = 0; i < stats.size(); i++) {
+        double total = stats[i].busySeconds + stats[i].idleSeconds;
+        std::cout << "Worker " << i << ": busy " << std::fixed << std::setprecision(3) << stats[i].busySeconds * 1000.0 << " ms"
+                  << ", idle " << stats[i].idleSeconds * 1000.0 << " ms"
+                  << " (" << std::setprecision(1) << (total > 0.0 ? 100.0 * stats[i].busySeconds / total : 0.0) << "% busy)"
+                  << ", jobs " << stats[i].jobsExecuted << ", stolen " << stats[i].jobsStolen << std::endl;
+    }
+}
+
+int runPerformanceAnalysis(const BenchmarkOptions& options) {
+#if !CDE_ENABLE_STATS
+    // The steps record no timings or counters, every result would read 0
+    std::cerr << "Built with CDE_ENABLE_STATS=0, the benchmark needs the step statistics" << std::endl;
+    return 1;
+#endif
+    benchmarkOptions = options;
+    benchmarkWorkerStats.clear();
+    {
+        // Every world of the benchmark starts the same workers
+        JobSystem jobs(options.numThreads, options.pinThreads);
+        benchmarkWorkers = jobs.numWorkers();
+        benchmarkPinned = jobs.threadsPinned();
+    }
 
-// Main function to run experiments
-//change main1 to main to run the test
-int main1() {
-    // Create output file
     std::ofstream outputFile("collision_performance_results.csv");
-    
-    // Write header
-    outputFile << "NumSpheres,Complexity,Radius,Velocity,Mass,WorldSize,Method,"
-               << "BroadTime_ms,NarrowTime_ms,HandleTime_ms,TotalTime_ms,"
-               << "PotentialCollisions,ActualCollisions" << std::endl;
+    writeCsvHeader(outputFile);
+    std::vector<BenchmarkResult> results;
     
     // Experiment parameters
-    float worldSize = 20.0f;
     const float defaultMass = 1.0f;
     const float defaultVelocity = 0.5f;
     const float defaultRadius = 1.0f;
-    const int defaultComplexity = 20;
-    
+
     std::cout << "Starting performance analysis..." << std::endl;
-    
-    std::cout << "\n=== Experiment 1: Varying Number of Objects ===" << std::endl;
-    // Experiment 1: Varying number of objects (1-50)
-    for (int numSpheres : {10, 30, 50, 100, 200, 500, 1000}) {
-        // Test Sweep and Prune method (method = 0)
-        measurePerformance(numSpheres, defaultComplexity, defaultRadius, 
-                          defaultVelocity, defaultMass, worldSize, 0, outputFile);
-    
-    }
+    std::cout << "Worker threads: " << benchmarkWorkers << (benchmarkPinned ? " (pinned)" : "") << std::endl;
+    std::cout << "Scene seed: " << options.seed << std::endl;
+    std::cout << "Steps per run: " << options.warmupSteps << " warmup, " << options.measuredSteps << " measured" << std::endl;
+    // Set CDE_SIMD=scalar|sse2|avx2|avx512 to benchmark another path than the best one
+    std::cout << "SIMD path: " << simdPathName(simdKernels().path)
+              << " (best supported: " << simdPathName(bestSimdPath()) << ")" << std::endl;
+    reportMemoryFootprint();
 
-    for (int numSpheres : {10, 30, 50, 100, 200, 500, 1000}) {
-        // Test Brute Force method (method = 1)
-        measurePerformance(numSpheres, defaultComplexity, defaultRadius, 
-                          defaultVelocity, defaultMass, worldSize, 1, outputFile);
+    // Every path must give the scalar path's bits, on both broad phases, with a sphere count that leaves
+    // a scalar tail after every vector loop
+    WorldSettings paritySettings = {};
+    paritySettings.numSpheres = 1003;
+    paritySettings.minRadius = 0.2f;
+    paritySettings.maxRadius = 1.0f;
+    paritySettings.minVelocity = -5.0f;
+    paritySettings.maxVelocity = 5.0f;
+    paritySettings.minMass = 0.5f;
+    paritySettings.maxMass = 10.0f;
+    paritySettings.worldSize = 20.0f;
+    paritySettings.seed = options.seed;
+    paritySettings.numThreads = benchmarkWorkers;
+    paritySettings.pinThreads = benchmarkPinned;
+    paritySettings.headless = true;
+    bool simdParity = true;
+    for (int method : {0, 1}) {
+        paritySettings.method = method;
+        simdParity = checkSimdParity(paritySettings, 50, options.stepTime) && simdParity;
     }
+    if (!simdParity)
+        std::cout << "Warning: the SIMD paths don't give the same results, comparing them is meaningless" << std::endl;
     
-    std::cout << "\n=== Experiment 2: Varying Object Complexity ===" << std::endl;
-    // Experiment 2: Varying object complexity
-    for (int complexity : {20, 50, 100, 200, 300, 400, 800}) {
-        // Use 20 objects for these tests
-        const int testSpheres = 20;
-        
-        // Test Sweep and Prune method (method = 0)
-        measurePerformance(testSpheres, complexity, defaultRadius, 
-                          defaultVelocity, defaultMass, worldSize, 0, outputFile);
-        
-    }
-    for (int complexity : {20, 50, 100, 200, 300, 400, 800}) {
-        // Use 20 objects for these tests
-        const int testSpheres = 20;
-        // Test Brute Force method (method = 1)
-        measurePerformance(testSpheres, complexity, defaultRadius, 
-                          defaultVelocity, defaultMass, worldSize, 1, outputFile);
+    std::cout << "\n=== Experiment 1: Varying Number of Objects ===" << std::endl;
+    // Experiment 1: Varying number of objects
+    for (int numSpheres : {10, 30, 50, 100, 200, 500, 1000}) {
+        BenchmarkScene scene = { 0, numSpheres, defaultRadius, defaultRadius, defaultVelocity, defaultMass, 20.0f };
+        runScene(scene, results, outputFile);
     }
     
-    std::cout << "\n=== Experiment 3: Varying Object Size ===" << std::endl;
-    // Experiment 3: Varying object size (relative to world)
+    std::cout << "\n=== Experiment 2: Varying Object Size ===" << std::endl;
+    // Experiment 2: Varying object size (relative to world), with 100 objects in a larger world
     for (float radius : {0.5f, 2.0f, 5.0f, 7.0f, 10.0f, 15.0f}) {
-        // Use 20 objects for these tests
-        const int testSpheres = 100;
-        
-        worldSize = 50.0f; // Reset world size for this test
-        
-        // Test Sweep and Prune method (method = 0)
-        measurePerformance(testSpheres, defaultComplexity, radius, 
-                          defaultVelocity, defaultMass, worldSize, 0, outputFile);
-    
-    }
-
-    for (float radius : {0.5f, 2.0f, 5.0f, 7.0f, 10.0f, 15.0f}) {
-        // Use 20 objects for these tests
-        const int testSpheres = 100;
-        // Test Brute Force method (method = 1)
-        worldSize = 50.0f; // Reset world size for this test
-        measurePerformance(testSpheres, defaultComplexity, radius, 
-                          defaultVelocity, defaultMass, worldSize, 1, outputFile);
+        BenchmarkScene scene = { 0, 100, radius, radius, defaultVelocity, defaultMass, 50.0f };
+        runScene(scene, results, outputFile);
     }
     
-    std::cout << "\n=== Experiment 4: Varying Velocity ===" << std::endl;
-    // Experiment 4: Varying object velocities
+    std::cout << "\n=== Experiment 3: Varying Velocity ===" << std::endl;
+    // Experiment 3: Varying object velocities, with 20 objects
     for (float velocity : {0.5f, 1.0f, 2.0f, 5.0f, 10.0f}) {
-        worldSize = 20.0f; // Reset world size for this test
-        // Use 20 objects for these tests
-        const int testSpheres = 20;
-        
-        // Test Sweep and Prune method (method = 0)
-        measurePerformance(testSpheres, defaultComplexity, defaultRadius, 
-                          velocity, defaultMass, worldSize, 0, outputFile);
-    
+        BenchmarkScene scene = { 0, 20, defaultRadius, defaultRadius, velocity, defaultMass, 20.0f };
+        runScene(scene, results, outputFile);
     }
-    for (float velocity : {0.5f, 1.0f, 2.0f, 5.0f, 10.0f}) {
-        worldSize = 20.0f; // Reset world size for this test
-        // Use 20 objects for these tests
-        const int testSpheres = 20;
-        // Test Brute Force method (method = 1)
-        measurePerformance(testSpheres, defaultComplexity, defaultRadius, 
-                          velocity, defaultMass, worldSize, 1, outputFile);
+
+    std::cout << "\n=== Experiment 4: Scenarios ===" << std::endl;
+    // Experiment 4: every scene generator, each broad phase on its best and worst case
+    for (int scenario = 0; scenario < scenarioCount(); scenario++) {
+        if (options.scenario >= 0 && scenario != options.scenario)
+            continue;
+        BenchmarkScene scene = { scenario, 1000, 0.2f, defaultRadius, 5.0f, defaultMass, 20.0f };
+        runScene(scene, results, outputFile);
     }
     // Close the output file
     outputFile.close();
+    writeJson(results, simdParity, "collision_performance_results.json");
+
+    std::cout << "\n=== Experiment 5: World Startup Time ===" << std::endl;
+    // Experiment 5: building the headless world
+    std::ofstream buildFile("world_build_results.csv");
+    buildFile << "NumSpheres,Workers,BuildTime_ms,Seed" << std::endl;
+    for (int numSpheres : {10000, 100000, 1000000}) {
+        measureWorldBuild(numSpheres, buildFile);
+    }
+    buildFile.close();
+
+    reportWorkerStats(benchmarkWorkerStats);
     
-    std::cout << "\nPerformance analysis completed. Results saved to collision_performance_results.csv" << std::endl;
+    std::cout << "\nPerformance analysis completed. Results saved to collision_performance_results.csv, "
+              << "collision_performance_results.json and world_build_results.csv" << std::endl;
     
     return 0;
-}
\ No newline at end of file
+}
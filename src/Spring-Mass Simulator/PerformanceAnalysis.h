@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include "SimulatorWorld.h"
+
+//Steady-state benchmark of the collision pipeline, run by SimulatorCli --benchmark.
+//Every configuration builds a headless SimulatorWorld of one seeded scene per broad phase method, the seed gives the
+//methods the same spheres. Each run steps the world warmupSteps times before timing measuredSteps more steps, which
+//lets the arenas reach their size and the sweep order settle: what is measured is a step in the middle of a
+//simulation, not the first one. The phases are timed in whole nanoseconds by the world's own step statistics
+//(StepStats.h) and reported as their median, 95th and 99th percentile. Builds with CDE_ENABLE_STATS=0 have no
+//statistics, the benchmark refuses to run there rather than write results that read 0.
+
+struct BenchmarkOptions {
+    int warmupSteps;   // Steps run before timing, per configuration and method
+    int measuredSteps; // Steps timed, per configuration and method
+    float stepTime;    // Duration of a step
+    int numThreads;    // Workers of the job system, 0 uses every hardware thread
+    bool pinThreads;
+    uint64_t seed;     // Seed of every scene, rerunning with it rebuilds the exact same spheres
+    int scenario;      // Only run this scenario of the scenario experiment (see findScenario), -1 runs every one
+};
+
+// Run every experiment, the results go to collision_performance_results.csv and .json and world_build_results.csv
+// Returns 1 without running anything in builds with CDE_ENABLE_STATS=0
+int runPerformanceAnalysis(const BenchmarkOptions& options);
+
+// Step the scene of settings (headless) steps times with every SIMD path this CPU supports and compare the sphere
+// arrays bit for bit with the scalar path's, printing the first difference. The spheres of the scene are also
+// integrated once placed within a rounding error of the walls. The selected path is kept.
+bool checkSimdParity(const WorldSettings& settings, int steps, float stepTime);
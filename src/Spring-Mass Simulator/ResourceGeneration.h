@@ -0,0 +1,12 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+//Generation stamps of data mirrored elsewhere, on the GPU or in the render data of a world.
+//Data gets a new stamp whenever it changes, and stamps are unique for the whole process, so a copy uploaded from
+//one world is never mistaken for the data of another world that happens to live at the same address.
+
+inline uint64_t nextResourceGeneration() {
+    static std::atomic<uint64_t> counter(0);
+    return counter.fetch_add(1, std::memory_order_relaxed) + 1; // 0 is left for "never uploaded"
+}
@@ -0,0 +1,187 @@
+#include "Scenario.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Center moved inside the walls, so the sphere starts within the world
+static glm::vec3 insideWorld(const glm::vec3& center, float radius, float worldSize) {
+    float limit = std::max(0.0f, worldSize - radius);
+    return glm::clamp(center, glm::vec3(-limit), glm::vec3(limit));
+}
+
+static glm::vec3 randomVelocity(const ScenarioSettings& settings, CounterRng& rng, float scale) {
+    glm::vec3 velocity;
+    velocity.x = rng.randomFloat(settings.minVelocity, settings.maxVelocity) * scale;
+    velocity.y = rng.randomFloat(settings.minVelocity, settings.maxVelocity) * scale;
+    velocity.z = rng.randomFloat(settings.minVelocity, settings.maxVelocity) * scale;
+    return velocity;
+}
+
+// Largest speed along one axis the velocity range allows
+static float maxSpeed(const ScenarioSettings& settings) {
+    return std::max(std::fabs(settings.minVelocity), std::fabs(settings.maxVelocity));
+}
+
+// Spheres spread evenly over the whole world, with velocities in the full range
+// Draws in the same order as SimulatorWorld always did, so a seed still builds the scene it built before
+static ScenarioSphere uniformGas(const ScenarioSettings& settings, int, CounterRng& rng) {
+    ScenarioSphere sphere;
+    sphere.center.x = rng.randomFloat(-settings.worldSize, settings.worldSize);
+    sphere.center.y = rng.randomFloat(-settings.worldSize, settings.worldSize);
+    sphere.center.z = rng.randomFloat(-settings.worldSize, settings.worldSize);
+    sphere.radius = rng.randomFloat(settings.minRadius, settings.maxRadius);
+    sphere.velocity = randomVelocity(settings, rng, 1.0f);
+    sphere.mass = rng.randomFloat(settings.minMass, settings.maxMass);
+    return sphere;
+}
+
+// Spheres spread around a few centers with a normal distribution, most of the world is empty
+static ScenarioSphere gaussianClusters(const ScenarioSettings& settings, int i, CounterRng& rng) {
+    const int clusterCount = 8;
+    const float clusterDeviation = 0.08f; // Of the world size
+
+    // The cluster centers use the streams after the spheres' ones
+    int cluster = i % clusterCount;
+    CounterRng clusterRng(settings.seed, static_cast<uint64_t>(settings.numSpheres) + cluster);
+    glm::vec3 clusterCenter;
+    clusterCenter.x = clusterRng.randomFloat(-0.6f * settings.worldSize, 0.6f * settings.worldSize);
+    clusterCenter.y = clusterRng.randomFloat(-0.6f * settings.worldSize, 0.6f * settings.worldSize);
+    clusterCenter.z = clusterRng.randomFloat(-0.6f * settings.worldSize, 0.6f * settings.worldSize);
+
+    ScenarioSphere sphere;
+    float deviation = clusterDeviation * settings.worldSize;
+    glm::vec3 offset;
+    offset.x = rng.gaussianFloat(0.0f, deviation);
+    offset.y = rng.gaussianFloat(0.0f, deviation);
+    offset.z = rng.gaussianFloat(0.0f, deviation);
+    sphere.radius = rng.randomFloat(settings.minRadius, settings.maxRadius);
+    sphere.center = insideWorld(clusterCenter + offset, sphere.radius, settings.worldSize);
+    sphere.velocity = randomVelocity(settings, rng, 1.0f);
+    sphere.mass = rng.randomFloat(settings.minMass, settings.maxMass);
+    return sphere;
+}
+
+// Cubic lattice centered in the world, spaced by twice the mean radius so about half of the neighbours touch
+// The lattice is squeezed (and the spheres overlap more) when it doesn't fit, the velocities only jitter the packing
+static ScenarioSphere denseLattice(const ScenarioSettings& settings, int i, CounterRng& rng) {
+    int side = std::max(1, static_cast<int>(std::cbrt(static_cast<double>(settings.numSpheres))));
+    while (side * side * side < settings.numSpheres) side++;
+    float spacing = settings.minRadius + settings.maxRadius;
+    if (side > 1)
+        spacing = std::min(spacing, 2.0f * (settings.worldSize - settings.maxRadius) / (side - 1));
+
+    float offset = 0.5f * (side - 1);
+    ScenarioSphere sphere;
+    sphere.center = glm::vec3(i % side - offset, (i / side) % side - offset, i / (side * side) - offset) * spacing;
+    sphere.radius = rng.randomFloat(settings.minRadius, settings.maxRadius);
+    sphere.velocity = randomVelocity(settings, rng, 0.1f);
+    sphere.mass = rng.randomFloat(settings.minMass, settings.maxMass);
+    return sphere;
+}
+
+// Every sphere on the x axis, moving along it
+// On y and z every sphere's interval overlaps every other one, the worst case of sweep and prune
+static ScenarioSphere sphereLine(const ScenarioSettings& settings, int i, CounterRng& rng) {
+    float length = 2.0f * std::max(0.0f, settings.worldSize - settings.maxRadius);
+    float spacing = settings.numSpheres > 1 ? length / (settings.numSpheres - 1) : 0.0f;
+
+    ScenarioSphere sphere;
+    sphere.center = glm::vec3(-0.5f * length + i * spacing, 0.0f, 0.0f);
+    sphere.radius = rng.randomFloat(settings.minRadius, settings.maxRadius);
+    sphere.velocity = glm::vec3(rng.randomFloat(settings.minVelocity, settings.maxVelocity), 0.0f, 0.0f);
+    sphere.mass = rng.randomFloat(settings.minMass, settings.maxMass);
+    return sphere;
+}
+
+// Uniform gas of small spheres with one sphere in ten near the largest radius
+// The large spheres overlap the intervals of many small ones, which hurts methods sized on the average radius
+static ScenarioSphere bimodalRadii(const ScenarioSettings& settings, int, CounterRng& rng) {
+    const float largeShare = 0.1f;
+    const float modeWidth = 0.1f; // Of the radius range
+
+    ScenarioSphere sphere;
+    float width = modeWidth * (settings.maxRadius - settings.minRadius);
+    bool large = rng.randomFloat(0.0f, 1.0f) < largeShare;
+    sphere.radius = large ? rng.randomFloat(settings.maxRadius - width, settings.maxRadius)
+                          : rng.randomFloat(settings.minRadius, settings.minRadius + width);
+    glm::vec3 center;
+    center.x = rng.randomFloat(-settings.worldSize, settings.worldSize);
+    center.y = rng.randomFloat(-settings.worldSize, settings.worldSize);
+    center.z = rng.randomFloat(-settings.worldSize, settings.worldSize);
+    sphere.center = insideWorld(center, sphere.radius, settings.worldSize);
+    sphere.velocity = randomVelocity(settings, rng, 1.0f);
+    sphere.mass = rng.randomFloat(settings.minMass, settings.maxMass);
+    return sphere;
+}
+
+// A ball of resting spheres in the middle of the world, hit by a few fast spheres fired from the -x wall
+// The projectiles cross many spheres' intervals every step and break up the ball
+static ScenarioSphere projectiles(const ScenarioSettings& settings, int i, CounterRng& rng) {
+    const float ballRadius = 0.3f; // Of the world size
+    const float projectileSpeed = 10.0f; // Times the largest speed of the velocity range
+    int projectileCount = std::max(1, settings.numSpheres / 20);
+
+    ScenarioSphere sphere;
+    sphere.radius = rng.randomFloat(settings.minRadius, settings.maxRadius);
+    sphere.mass = rng.randomFloat(settings.minMass, settings.maxMass);
+    if (i < projectileCount) {
+        glm::vec3 center;
+        center.x = -settings.worldSize;
+        center.y = rng.randomFloat(-0.5f * ballRadius * settings.worldSize, 0.5f * ballRadius * settings.worldSize);
+        center.z = rng.randomFloat(-0.5f * ballRadius * settings.worldSize, 0.5f * ballRadius * settings.worldSize);
+        sphere.center = insideWorld(center, sphere.radius, settings.worldSize);
+        sphere.velocity = glm::vec3(projectileSpeed * maxSpeed(settings), 0.0f, 0.0f);
+        return sphere;
+    }
+
+    // Uniform in the ball: a normal direction and a distance growing with the cube root
+    glm::vec3 direction;
+    direction.x = rng.gaussianFloat(0.0f, 1.0f);
+    direction.y = rng.gaussianFloat(0.0f, 1.0f);
+    direction.z = rng.gaussianFloat(0.0f, 1.0f);
+    float length = glm::length(direction);
+    float distance = ballRadius * settings.worldSize * std::cbrt(rng.randomFloat(0.0f, 1.0f));
+    sphere.center = length > 0.0f ? direction * (distance / length) : glm::vec3(0.0f);
+    sphere.velocity = glm::vec3(0.0f);
+    return sphere;
+}
+
+// Spheres dropped from the upper half of the world, falling onto the floor
+// The walls reflect without losing energy, so the heap keeps bouncing instead of coming to rest,
+// but most spheres spend their time packed close to the floor
+static ScenarioSphere settlingUnderGravity(const ScenarioSettings& settings, int, CounterRng& rng) {
+    ScenarioSphere sphere;
+    glm::vec3 center;
+    center.x = rng.randomFloat(-settings.worldSize, settings.worldSize);
+    center.y = rng.randomFloat(0.0f, settings.worldSize);
+    center.z = rng.randomFloat(-settings.worldSize, settings.worldSize);
+    sphere.radius = rng.randomFloat(settings.minRadius, settings.maxRadius);
+    sphere.center = insideWorld(center, sphere.radius, settings.worldSize);
+    sphere.velocity = randomVelocity(settings, rng, 0.1f);
+    sphere.mass = rng.randomFloat(settings.minMass, settings.maxMass);
+    return sphere;
+}
+
+static const Scenario scenarios[] = {
+    { "uniform", "Uniform gas over the whole world", uniformGas, glm::vec3(0.0f) },
+    { "clusters", "Gaussian clusters around 8 centers", gaussianClusters, glm::vec3(0.0f) },
+    { "lattice", "Dense cubic lattice, about half the neighbours touching", denseLattice, glm::vec3(0.0f) },
+    { "line", "Every sphere on the x axis, sweep and prune worst case", sphereLine, glm::vec3(0.0f) },
+    { "bimodal", "Small spheres with one in ten large", bimodalRadii, glm::vec3(0.0f) },
+    { "projectiles", "Fast spheres fired into a resting ball", projectiles, glm::vec3(0.0f) },
+    { "gravity", "Spheres falling onto the floor", settlingUnderGravity, glm::vec3(0.0f, -9.81f, 0.0f) },
+};
+
+int scenarioCount() {
+    return static_cast<int>(sizeof(scenarios) / sizeof(scenarios[0]));
+}
+
+const Scenario& scenarioAt(int index) {
+    return scenarios[index];
+}
+
+int findScenario(const char* name) {
+    for (int i = 0; i < scenarioCount(); i++)
+        if (std::strcmp(scenarios[i].name, name) == 0) return i;
+    return -1;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "CounterRng.h"
+
+//Generators of the initial state of a scene, looked up by name.
+//Uniform random positions and velocities are the best case of most broad phases and look nothing like a real scene,
+//so the other scenarios stress one case each: clustered or packed spheres, all spheres on one line (every interval
+//overlaps every other on two axes, the worst case of sweep and prune), very different radii, fast spheres crossing
+//the world and a heap settling under gravity.
+//A generator builds sphere i from the random stream of sphere i only (state shared by several spheres, like a
+//cluster center, comes from its own streams), so a scene depends on the seed and not on the threads building it.
+
+// Parameters a scene is generated from, the same ranges as WorldSettings
+struct ScenarioSettings {
+    int numSpheres;
+    float minRadius;
+    float maxRadius;
+    float minVelocity; // Range of each velocity component
+    float maxVelocity;
+    float minMass;
+    float maxMass;
+    float worldSize;   // Half extent of the world cube
+    uint64_t seed;
+};
+
+// Initial state of one sphere
+struct ScenarioSphere {
+    glm::vec3 center;
+    float radius;
+    glm::vec3 velocity;
+    float mass;
+};
+
+struct Scenario {
+    const char* name;
+    const char* description;
+    // Sphere i of the scene, rng is the stream of sphere i and may be drawn from again afterwards
+    ScenarioSphere (*generate)(const ScenarioSettings& settings, int i, CounterRng& rng);
+    glm::vec3 gravity; // Acceleration of every sphere during the simulation
+};
+
+// Every scenario, index 0 is the uniform gas the worlds were always built from
+int scenarioCount();
+const Scenario& scenarioAt(int index);
+
+// Index of the scenario with this name, -1 if there is none
+int findScenario(const char* name);
@@ -0,0 +1,618 @@
+#include "SimdKernels.h"
+#include "CpuFeatures.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#ifdef CDE_X86
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Index of the lowest set bit, mask must not be 0
+static inline int lowestBit(unsigned int mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+static inline int popCount(unsigned int mask) {
+    int count = 0;
+    for (; mask; mask &= mask - 1) count++;
+    return count;
+}
+
+// Same bits as a float but ordered like one when compared as unsigned integers
+// Adding 0 turns -0 into +0, the two zeros compare equal as floats and must get the same key
+static inline uint32_t floatSortKey(float value) {
+    value += 0.0f;
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t mask = static_cast<uint32_t>(static_cast<int32_t>(bits) >> 31) | 0x80000000u;
+    return bits ^ mask;
+}
+
+//
+// Integration and boundary reflection
+//
+
+// Scalar reference: integrate one axis and reflect it at the walls, returns 1 if it was reflected
+// The center is compared with worldSize - radius, not center + radius with worldSize: the rounding of the two
+// differs near the wall, and the vector kernels (and the scalar tails of their loops) compute the limits this way
+static inline int integrateAxisScalar(float& center, float& velocity, float radius, float deltaTime, float worldSize) {
+    const float high = worldSize - radius;
+    const float low = radius - worldSize;
+    center += velocity * deltaTime;
+    if (center > high) {
+        velocity = -velocity;
+        center = high;
+        return 1;
+    } else if (center < low) {
+        velocity = -velocity;
+        center = low;
+        return 1;
+    }
+    return 0;
+}
+
+static int integrateSpheresScalar(SphereStore& spheres, int begin, int end, float deltaTime, float worldSize) {
+    float* centerX = spheres.centerX.data();
+    float* centerY = spheres.centerY.data();
+    float* centerZ = spheres.centerZ.data();
+    float* velocityX = spheres.velocityX.data();
+    float* velocityY = spheres.velocityY.data();
+    float* velocityZ = spheres.velocityZ.data();
+    const float* radius = spheres.radius.data();
+
+    int bounces = 0;
+    for (int i = begin; i < end; i++) {
+        bounces += integrateAxisScalar(centerX[i], velocityX[i], radius[i], deltaTime, worldSize);
+        bounces += integrateAxisScalar(centerY[i], velocityY[i], radius[i], deltaTime, worldSize);
+        bounces += integrateAxisScalar(centerZ[i], velocityZ[i], radius[i], deltaTime, worldSize);
+    }
+    return bounces;
+}
+
+#ifdef CDE_X86
+
+// SSE2: 4 spheres at a time, blends are done with and/andnot/or masks
+static inline int integrateAxisSSE2(float* center, float* velocity, int i, __m128 low, __m128 high, __m128 deltaTime, __m128 signBit) {
+    __m128 c = _mm_loadu_ps(center + i);
+    __m128 v = _mm_loadu_ps(velocity + i);
+    c = _mm_add_ps(c, _mm_mul_ps(v, deltaTime));
+
+    __m128 above = _mm_cmpgt_ps(c, high);
+    __m128 below = _mm_andnot_ps(above, _mm_cmplt_ps(c, low));
+    c = _mm_or_ps(_mm_andnot_ps(_mm_or_ps(above, below), c), _mm_or_ps(_mm_and_ps(above, high), _mm_and_ps(below, low)));
+    __m128 reflected = _mm_or_ps(above, below);
+    v = _mm_xor_ps(v, _mm_and_ps(reflected, signBit));
+
+    _mm_storeu_ps(center + i, c);
+    _mm_storeu_ps(velocity + i, v);
+    return popCount(static_cast<unsigned int>(_mm_movemask_ps(reflected)));
+}
+
+static int integrateSpheresSSE2(SphereStore& spheres, int begin, int end, float deltaTime, float worldSize) {
+    const __m128 dt = _mm_set1_ps(deltaTime);
+    const __m128 size = _mm_set1_ps(worldSize);
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    const float* radius = spheres.radius.data();
+
+    int bounces = 0;
+    int i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 r = _mm_loadu_ps(radius + i);
+        __m128 high = _mm_sub_ps(size, r); // worldSize - r
+        __m128 low = _mm_sub_ps(r, size);  // -worldSize + r
+        bounces += integrateAxisSSE2(spheres.centerX.data(), spheres.velocityX.data(), i, low, high, dt, signBit);
+        bounces += integrateAxisSSE2(spheres.centerY.data(), spheres.velocityY.data(), i, low, high, dt, signBit);
+        bounces += integrateAxisSSE2(spheres.centerZ.data(), spheres.velocityZ.data(), i, low, high, dt, signBit);
+    }
+    return bounces + integrateSpheresScalar(spheres, i, end, deltaTime, worldSize);
+}
+
+// AVX2: 8 spheres at a time
+CDE_TARGET_AVX2 static inline int integrateAxisAVX2(float* center, float* velocity, int i, __m256 low, __m256 high, __m256 deltaTime, __m256 signBit) {
+    __m256 c = _mm256_loadu_ps(center + i);
+    __m256 v = _mm256_loadu_ps(velocity + i);
+    c = _mm256_add_ps(c, _mm256_mul_ps(v, deltaTime));
+
+    __m256 above = _mm256_cmp_ps(c, high, _CMP_GT_OQ);
+    __m256 below = _mm256_andnot_ps(above, _mm256_cmp_ps(c, low, _CMP_LT_OQ));
+    c = _mm256_blendv_ps(c, high, above);
+    c = _mm256_blendv_ps(c, low, below);
+    __m256 reflected = _mm256_or_ps(above, below);
+    v = _mm256_xor_ps(v, _mm256_and_ps(reflected, signBit));
+
+    _mm256_storeu_ps(center + i, c);
+    _mm256_storeu_ps(velocity + i, v);
+    return popCount(static_cast<unsigned int>(_mm256_movemask_ps(reflected)));
+}
+
+CDE_TARGET_AVX2 static int integrateSpheresAVX2(SphereStore& spheres, int begin, int end, float deltaTime, float worldSize) {
+    const __m256 dt = _mm256_set1_ps(deltaTime);
+    const __m256 size = _mm256_set1_ps(worldSize);
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+    const float* radius = spheres.radius.data();
+
+    int bounces = 0;
+    int i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 r = _mm256_loadu_ps(radius + i);
+        __m256 high = _mm256_sub_ps(size, r);
+        __m256 low = _mm256_sub_ps(r, size);
+        bounces += integrateAxisAVX2(spheres.centerX.data(), spheres.velocityX.data(), i, low, high, dt, signBit);
+        bounces += integrateAxisAVX2(spheres.centerY.data(), spheres.velocityY.data(), i, low, high, dt, signBit);
+        bounces += integrateAxisAVX2(spheres.centerZ.data(), spheres.velocityZ.data(), i, low, high, dt, signBit);
+    }
+    return bounces + integrateSpheresScalar(spheres, i, end, deltaTime, worldSize);
+}
+
+// AVX-512: 16 spheres at a time, with mask registers instead of blend vectors
+CDE_TARGET_AVX512 static inline int integrateAxisAVX512(float* center, float* velocity, int i, __m512 low, __m512 high, __m512 deltaTime, __m512i signBit) {
+    __m512 c = _mm512_loadu_ps(center + i);
+    __m512 v = _mm512_loadu_ps(velocity + i);
+    // The explicit rounding keeps the compiler from fusing this into an FMA, every path must give the same bits
+    c = _mm512_add_ps(c, _mm512_mul_round_ps(v, deltaTime, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+
+    __mmask16 above = _mm512_cmp_ps_mask(c, high, _CMP_GT_OQ);
+    __mmask16 below = static_cast<__mmask16>(_mm512_cmp_ps_mask(c, low, _CMP_LT_OQ) & ~above);
+    c = _mm512_mask_blend_ps(above, c, high);
+    c = _mm512_mask_blend_ps(below, c, low);
+    __m512i bits = _mm512_castps_si512(v);
+    __mmask16 reflected = static_cast<__mmask16>(above | below);
+    v = _mm512_castsi512_ps(_mm512_mask_xor_epi32(bits, reflected, bits, signBit));
+
+    _mm512_storeu_ps(center + i, c);
+    _mm512_storeu_ps(velocity + i, v);
+    return popCount(reflected);
+}
+
+CDE_TARGET_AVX512 static int integrateSpheresAVX512(SphereStore& spheres, int begin, int end, float deltaTime, float worldSize) {
+    const __m512 dt = _mm512_set1_ps(deltaTime);
+    const __m512 size = _mm512_set1_ps(worldSize);
+    const __m512i signBit = _mm512_set1_epi32(static_cast<int>(0x80000000u));
+    const float* radius = spheres.radius.data();
+
+    int bounces = 0;
+    int i = begin;
+    for (; i + 16 <= end; i += 16) {
+        __m512 r = _mm512_loadu_ps(radius + i);
+        __m512 high = _mm512_sub_ps(size, r);
+        __m512 low = _mm512_sub_ps(r, size);
+        bounces += integrateAxisAVX512(spheres.centerX.data(), spheres.velocityX.data(), i, low, high, dt, signBit);
+        bounces += integrateAxisAVX512(spheres.centerY.data(), spheres.velocityY.data(), i, low, high, dt, signBit);
+        bounces += integrateAxisAVX512(spheres.centerZ.data(), spheres.velocityZ.data(), i, low, high, dt, signBit);
+    }
+    return bounces + integrateSpheresScalar(spheres, i, end, deltaTime, worldSize);
+}
+
+#endif
+
+//
+// Brute force overlap row
+//
+
+static int overlapRowScalar(const SphereStore& spheres, int i, int begin, int end, uint32_t* hits) {
+    const float* centerX = spheres.centerX.data();
+    const float* centerY = spheres.centerY.data();
+    const float* centerZ = spheres.centerZ.data();
+    const float* radius = spheres.radius.data();
+
+    int count = 0;
+    for (int j = begin; j < end; j++) {
+        float dx = centerX[j] - centerX[i];
+        float dy = centerY[j] - centerY[i];
+        float dz = centerZ[j] - centerZ[i];
+        float radiusSum = radius[i] + radius[j];
+        if (dx * dx + dy * dy + dz * dz <= radiusSum * radiusSum)
+            hits[count++] = static_cast<uint32_t>(j);
+    }
+    return count;
+}
+
+#ifdef CDE_X86
+
+static int overlapRowSSE2(const SphereStore& spheres, int i, int begin, int end, uint32_t* hits) {
+    const float* centerX = spheres.centerX.data();
+    const float* centerY = spheres.centerY.data();
+    const float* centerZ = spheres.centerZ.data();
+    const float* radius = spheres.radius.data();
+    const __m128 x = _mm_set1_ps(centerX[i]);
+    const __m128 y = _mm_set1_ps(centerY[i]);
+    const __m128 z = _mm_set1_ps(centerZ[i]);
+    const __m128 r = _mm_set1_ps(radius[i]);
+
+    int count = 0;
+    int j = begin;
+    for (; j + 4 <= end; j += 4) {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(centerX + j), x);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(centerY + j), y);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(centerZ + j), z);
+        __m128 radiusSum = _mm_add_ps(r, _mm_loadu_ps(radius + j));
+        __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_ps(_mm_cmple_ps(distance2, _mm_mul_ps(radiusSum, radiusSum))));
+        for (; mask; mask &= mask - 1)
+            hits[count++] = static_cast<uint32_t>(j + lowestBit(mask));
+    }
+    return count + overlapRowScalar(spheres, i, j, end, hits + count);
+}
+
+CDE_TARGET_AVX2 static int overlapRowAVX2(const SphereStore& spheres, int i, int begin, int end, uint32_t* hits) {
+    const float* centerX = spheres.centerX.data();
+    const float* centerY = spheres.centerY.data();
+    const float* centerZ = spheres.centerZ.data();
+    const float* radius = spheres.radius.data();
+    const __m256 x = _mm256_set1_ps(centerX[i]);
+    const __m256 y = _mm256_set1_ps(centerY[i]);
+    const __m256 z = _mm256_set1_ps(centerZ[i]);
+    const __m256 r = _mm256_set1_ps(radius[i]);
+
+    int count = 0;
+    int j = begin;
+    for (; j + 8 <= end; j += 8) {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(centerX + j), x);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(centerY + j), y);
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(centerZ + j), z);
+        __m256 radiusSum = _mm256_add_ps(r, _mm256_loadu_ps(radius + j));
+        __m256 distance2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+        unsigned int mask = static_cast<unsigned int>(_mm256_movemask_ps(_mm256_cmp_ps(distance2, _mm256_mul_ps(radiusSum, radiusSum), _CMP_LE_OQ)));
+        for (; mask; mask &= mask - 1)
+            hits[count++] = static_cast<uint32_t>(j + lowestBit(mask));
+    }
+    return count + overlapRowScalar(spheres, i, j, end, hits + count);
+}
+
+CDE_TARGET_AVX512 static int overlapRowAVX512(const SphereStore& spheres, int i, int begin, int end, uint32_t* hits) {
+    const float* centerX = spheres.centerX.data();
+    const float* centerY = spheres.centerY.data();
+    const float* centerZ = spheres.centerZ.data();
+    const float* radius = spheres.radius.data();
+    const __m512 x = _mm512_set1_ps(centerX[i]);
+    const __m512 y = _mm512_set1_ps(centerY[i]);
+    const __m512 z = _mm512_set1_ps(centerZ[i]);
+    const __m512 r = _mm512_set1_ps(radius[i]);
+    const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const int rounding = _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC;
+
+    int count = 0;
+    int j = begin;
+    for (; j + 16 <= end; j += 16) {
+        __m512 dx = _mm512_sub_ps(_mm512_loadu_ps(centerX + j), x);
+        __m512 dy = _mm512_sub_ps(_mm512_loadu_ps(centerY + j), y);
+        __m512 dz = _mm512_sub_ps(_mm512_loadu_ps(centerZ + j), z);
+        __m512 radiusSum = _mm512_add_ps(r, _mm512_loadu_ps(radius + j));
+        // Explicit rounding on the products keeps them from being fused into FMAs
+        __m512 distance2 = _mm512_add_ps(_mm512_add_ps(_mm512_mul_round_ps(dx, dx, rounding), _mm512_mul_round_ps(dy, dy, rounding)),
+                                         _mm512_mul_round_ps(dz, dz, rounding));
+        __mmask16 mask = _mm512_cmp_ps_mask(distance2, _mm512_mul_ps(radiusSum, radiusSum), _CMP_LE_OQ);
+        // Write the indices of the hits contiguously
+        _mm512_mask_compressstoreu_epi32(hits + count, mask, _mm512_add_epi32(_mm512_set1_epi32(j), lanes));
+        count += popCount(mask);
+    }
+    return count + overlapRowScalar(spheres, i, j, end, hits + count);
+}
+
+#endif
+
+//
+// Narrow phase prefilter
+//
+
+static size_t rejectSeparatedPairsScalar(const SphereStore& spheres, CollisionPair* pairs, size_t count) {
+    const float* centerX = spheres.centerX.data();
+    const float* centerY = spheres.centerY.data();
+    const float* centerZ = spheres.centerZ.data();
+    const float* radius = spheres.radius.data();
+
+    size_t kept = 0;
+    for (size_t k = 0; k < count; k++) {
+        uint32_t a = pairs[k].first;
+        uint32_t b = pairs[k].second;
+        float dx = centerX[b] - centerX[a];
+        float dy = centerY[b] - centerY[a];
+        float dz = centerZ[b] - centerZ[a];
+        float radiusSum = radius[a] + radius[b];
+        if (dx * dx + dy * dy + dz * dz <= radiusSum * radiusSum * contactSlack)
+            pairs[kept++] = pairs[k];
+    }
+    return kept;
+}
+
+#ifdef CDE_X86
+
+// Load one array at the first (or second) index of 4 pairs
+static inline __m128 gatherPairs4(const float* values, const CollisionPair* pairs, bool second) {
+    if (second)
+        return _mm_setr_ps(values[pairs[0].second], values[pairs[1].second], values[pairs[2].second], values[pairs[3].second]);
+    return _mm_setr_ps(values[pairs[0].first], values[pairs[1].first], values[pairs[2].first], values[pairs[3].first]);
+}
+
+static size_t rejectSeparatedPairsSSE2(const SphereStore& spheres, CollisionPair* pairs, size_t count) {
+    const float* centerX = spheres.centerX.data();
+    const float* centerY = spheres.centerY.data();
+    const float* centerZ = spheres.centerZ.data();
+    const float* radius = spheres.radius.data();
+    const __m128 slack = _mm_set1_ps(contactSlack);
+
+    size_t kept = 0;
+    size_t k = 0;
+    for (; k + 4 <= count; k += 4) {
+        const CollisionPair* block = pairs + k;
+        __m128 dx = _mm_sub_ps(gatherPairs4(centerX, block, true), gatherPairs4(centerX, block, false));
+        __m128 dy = _mm_sub_ps(gatherPairs4(centerY, block, true), gatherPairs4(centerY, block, false));
+        __m128 dz = _mm_sub_ps(gatherPairs4(centerZ, block, true), gatherPairs4(centerZ, block, false));
+        __m128 radiusSum = _mm_add_ps(gatherPairs4(radius, block, false), gatherPairs4(radius, block, true));
+        __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        __m128 limit = _mm_mul_ps(_mm_mul_ps(radiusSum, radiusSum), slack);
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_ps(_mm_cmple_ps(distance2, limit)));
+        // kept never passes k + lane, so compacting in place doesn't overwrite pairs still to be read
+        for (; mask; mask &= mask - 1)
+            pairs[kept++] = pairs[k + lowestBit(mask)];
+    }
+    for (; k < count; k++) {
+        CollisionPair pair = pairs[k];
+        if (rejectSeparatedPairsScalar(spheres, &pair, 1))
+            pairs[kept++] = pair;
+    }
+    return kept;
+}
+
+CDE_TARGET_AVX2 static size_t rejectSeparatedPairsAVX2(const SphereStore& spheres, CollisionPair* pairs, size_t count) {
+    const float* centerX = spheres.centerX.data();
+    const float* centerY = spheres.centerY.data();
+    const float* centerZ = spheres.centerZ.data();
+    const float* radius = spheres.radius.data();
+    const __m256 slack = _mm256_set1_ps(contactSlack);
+
+    size_t kept = 0;
+    size_t k = 0;
+    for (; k + 8 <= count; k += 8) {
+        // Split 8 interleaved (first, second) pairs into a vector of firsts and a vector of seconds
+        __m256 low = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pairs + k)));
+        __m256 high = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pairs + k + 4)));
+        __m256i first = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i second = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0));
+
+        __m256 dx = _mm256_sub_ps(_mm256_i32gather_ps(centerX, second, 4), _mm256_i32gather_ps(centerX, first, 4));
+        __m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(centerY, second, 4), _mm256_i32gather_ps(centerY, first, 4));
+        __m256 dz = _mm256_sub_ps(_mm256_i32gather_ps(centerZ, second, 4), _mm256_i32gather_ps(centerZ, first, 4));
+        __m256 radiusSum = _mm256_add_ps(_mm256_i32gather_ps(radius, first, 4), _mm256_i32gather_ps(radius, second, 4));
+        __m256 distance2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+        __m256 limit = _mm256_mul_ps(_mm256_mul_ps(radiusSum, radiusSum), slack);
+        unsigned int mask = static_cast<unsigned int>(_mm256_movemask_ps(_mm256_cmp_ps(distance2, limit, _CMP_LE_OQ)));
+        for (; mask; mask &= mask - 1)
+            pairs[kept++] = pairs[k + lowestBit(mask)];
+    }
+    for (; k < count; k++) {
+        CollisionPair pair = pairs[k];
+        if (rejectSeparatedPairsScalar(spheres, &pair, 1))
+            pairs[kept++] = pair;
+    }
+    return kept;
+}
+
+CDE_TARGET_AVX512 static size_t rejectSeparatedPairsAVX512(const SphereStore& spheres, CollisionPair* pairs, size_t count) {
+    const float* centerX = spheres.centerX.data();
+    const float* centerY = spheres.centerY.data();
+    const float* centerZ = spheres.centerZ.data();
+    const float* radius = spheres.radius.data();
+    const __m512 slack = _mm512_set1_ps(contactSlack);
+    const __m512i evenLanes = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    const __m512i oddLanes = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+    const int rounding = _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC;
+
+    size_t kept = 0;
+    size_t k = 0;
+    for (; k + 16 <= count; k += 16) {
+        __m512i low = _mm512_loadu_si512(pairs + k);
+        __m512i high = _mm512_loadu_si512(pairs + k + 8);
+        __m512i first = _mm512_permutex2var_epi32(low, evenLanes, high);
+        __m512i second = _mm512_permutex2var_epi32(low, oddLanes, high);
+
+        __m512 dx = _mm512_sub_ps(_mm512_i32gather_ps(second, centerX, 4), _mm512_i32gather_ps(first, centerX, 4));
+        __m512 dy = _mm512_sub_ps(_mm512_i32gather_ps(second, centerY, 4), _mm512_i32gather_ps(first, centerY, 4));
+        __m512 dz = _mm512_sub_ps(_mm512_i32gather_ps(second, centerZ, 4), _mm512_i32gather_ps(first, centerZ, 4));
+        __m512 radiusSum = _mm512_add_ps(_mm512_i32gather_ps(first, radius, 4), _mm512_i32gather_ps(second, radius, 4));
+        __m512 distance2 = _mm512_add_ps(_mm512_add_ps(_mm512_mul_round_ps(dx, dx, rounding), _mm512_mul_round_ps(dy, dy, rounding)),
+                                         _mm512_mul_round_ps(dz, dz, rounding));
+        __m512 limit = _mm512_mul_ps(_mm512_mul_ps(radiusSum, radiusSum), slack);
+        __mmask16 mask = _mm512_cmp_ps_mask(distance2, limit, _CMP_LE_OQ);
+
+        // A pair is one 64-bit lane, compress the kept ones of each half to the front
+        __mmask8 lowMask = static_cast<__mmask8>(mask & 0xff);
+        __mmask8 highMask = static_cast<__mmask8>(mask >> 8);
+        _mm512_mask_compressstoreu_epi64(pairs + kept, lowMask, low);
+        kept += popCount(lowMask);
+        _mm512_mask_compressstoreu_epi64(pairs + kept, highMask, high);
+        kept += popCount(highMask);
+    }
+    for (; k < count; k++) {
+        CollisionPair pair = pairs[k];
+        if (rejectSeparatedPairsScalar(spheres, &pair, 1))
+            pairs[kept++] = pair;
+    }
+    return kept;
+}
+
+#endif
+
+//
+// Endpoint sort keys
+//
+
+static void endpointKeysScalar(const float* center, const float* radius, int count, uint32_t* keys) {
+    for (int i = 0; i < count; i++) {
+        keys[i] = floatSortKey(center[i] - radius[i]);
+        keys[count + i] = floatSortKey(center[i] + radius[i]);
+    }
+}
+
+#ifdef CDE_X86
+
+static inline __m128i floatSortKeySSE2(__m128 value) {
+    __m128i bits = _mm_castps_si128(_mm_add_ps(value, _mm_setzero_ps()));
+    __m128i mask = _mm_or_si128(_mm_srai_epi32(bits, 31), _mm_set1_epi32(static_cast<int>(0x80000000u)));
+    return _mm_xor_si128(bits, mask);
+}
+
+static void endpointKeysSSE2(const float* center, const float* radius, int count, uint32_t* keys) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 c = _mm_loadu_ps(center + i);
+        __m128 r = _mm_loadu_ps(radius + i);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(keys + i), floatSortKeySSE2(_mm_sub_ps(c, r)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(keys + count + i), floatSortKeySSE2(_mm_add_ps(c, r)));
+    }
+    for (; i < count; i++) {
+        keys[i] = floatSortKey(center[i] - radius[i]);
+        keys[count + i] = floatSortKey(center[i] + radius[i]);
+    }
+}
+
+CDE_TARGET_AVX2 static inline __m256i floatSortKeyAVX2(__m256 value) {
+    __m256i bits = _mm256_castps_si256(_mm256_add_ps(value, _mm256_setzero_ps()));
+    __m256i mask = _mm256_or_si256(_mm256_srai_epi32(bits, 31), _mm256_set1_epi32(static_cast<int>(0x80000000u)));
+    return _mm256_xor_si256(bits, mask);
+}
+
+CDE_TARGET_AVX2 static void endpointKeysAVX2(const float* center, const float* radius, int count, uint32_t* keys) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 c = _mm256_loadu_ps(center + i);
+        __m256 r = _mm256_loadu_ps(radius + i);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(keys + i), floatSortKeyAVX2(_mm256_sub_ps(c, r)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(keys + count + i), floatSortKeyAVX2(_mm256_add_ps(c, r)));
+    }
+    for (; i < count; i++) {
+        keys[i] = floatSortKey(center[i] - radius[i]);
+        keys[count + i] = floatSortKey(center[i] + radius[i]);
+    }
+}
+
+CDE_TARGET_AVX512 static inline __m512i floatSortKeyAVX512(__m512 value) {
+    __m512i bits = _mm512_castps_si512(_mm512_add_ps(value, _mm512_setzero_ps()));
+    __m512i mask = _mm512_or_si512(_mm512_srai_epi32(bits, 31), _mm512_set1_epi32(static_cast<int>(0x80000000u)));
+    return _mm512_xor_si512(bits, mask);
+}
+
+CDE_TARGET_AVX512 static void endpointKeysAVX512(const float* center, const float* radius, int count, uint32_t* keys) {
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512 c = _mm512_loadu_ps(center + i);
+        __m512 r = _mm512_loadu_ps(radius + i);
+        _mm512_storeu_si512(keys + i, floatSortKeyAVX512(_mm512_sub_ps(c, r)));
+        _mm512_storeu_si512(keys + count + i, floatSortKeyAVX512(_mm512_add_ps(c, r)));
+    }
+    for (; i < count; i++) {
+        keys[i] = floatSortKey(center[i] - radius[i]);
+        keys[count + i] = floatSortKey(center[i] + radius[i]);
+    }
+}
+
+#endif
+
+//
+// Dispatch
+//
+
+static const SimdKernelTable scalarKernels = { SimdPath::Scalar, integrateSpheresScalar, overlapRowScalar, rejectSeparatedPairsScalar, endpointKeysScalar };
+#ifdef CDE_X86
+static const SimdKernelTable sse2Kernels = { SimdPath::SSE2, integrateSpheresSSE2, overlapRowSSE2, rejectSeparatedPairsSSE2, endpointKeysSSE2 };
+static const SimdKernelTable avx2Kernels = { SimdPath::AVX2, integrateSpheresAVX2, overlapRowAVX2, rejectSeparatedPairsAVX2, endpointKeysAVX2 };
+static const SimdKernelTable avx512Kernels = { SimdPath::AVX512, integrateSpheresAVX512, overlapRowAVX512, rejectSeparatedPairsAVX512, endpointKeysAVX512 };
+#endif
+
+static std::atomic<const SimdKernelTable*> selectedKernels(nullptr);
+
+bool isSimdPathSupported(SimdPath path) {
+    const CpuFeatures& cpu = CpuFeatures::get();
+    switch (path) {
+    case SimdPath::Scalar: return true;
+#ifdef CDE_X86
+    case SimdPath::SSE2: return cpu.sse2;
+    case SimdPath::AVX2: return cpu.avx2;
+    case SimdPath::AVX512: return cpu.avx512f;
+#endif
+    default: return false;
+    }
+}
+
+SimdPath bestSimdPath() {
+    if (isSimdPathSupported(SimdPath::AVX512)) return SimdPath::AVX512;
+    if (isSimdPathSupported(SimdPath::AVX2)) return SimdPath::AVX2;
+    if (isSimdPathSupported(SimdPath::SSE2)) return SimdPath::SSE2;
+    return SimdPath::Scalar;
+}
+
+const SimdKernelTable& simdKernelsFor(SimdPath path) {
+    switch (path) {
+#ifdef CDE_X86
+    case SimdPath::SSE2: return sse2Kernels;
+    case SimdPath::AVX2: return avx2Kernels;
+    case SimdPath::AVX512: return avx512Kernels;
+#endif
+    default: return scalarKernels;
+    }
+}
+
+bool selectSimdPath(SimdPath path) {
+    if (!isSimdPathSupported(path))
+        return false;
+    selectedKernels.store(&simdKernelsFor(path));
+    return true;
+}
+
+const SimdKernelTable& simdKernels() {
+    const SimdKernelTable* kernels = selectedKernels.load(std::memory_order_acquire);
+    if (kernels)
+        return *kernels;
+
+    // First use: the best path of this CPU, unless CDE_SIMD asks for a supported one
+    SimdPath path = bestSimdPath();
+    SimdPath requested;
+    const char* override = std::getenv("CDE_SIMD");
+    if (override && parseSimdPath(override, requested) && isSimdPathSupported(requested))
+        path = requested;
+    else if (override && *override)
+        // CDE_SIMD is there for A/B runs, a run that silently measured another path would be misleading
+        std::fprintf(stderr, "CDE_SIMD=%s is %s, using %s\n", override,
+            parseSimdPath(override, requested) ? "not supported by this CPU" : "not a SIMD path (scalar, sse2, avx2, avx512)",
+            simdPathName(path));
+
+    const SimdKernelTable* expected = nullptr;
+    selectedKernels.compare_exchange_strong(expected, &simdKernelsFor(path));
+    return *selectedKernels.load(std::memory_order_acquire);
+}
+
+const char* simdPathName(SimdPath path) {
+    switch (path) {
+    case SimdPath::SSE2: return "SSE2";
+    case SimdPath::AVX2: return "AVX2";
+    case SimdPath::AVX512: return "AVX-512";
+    default: return "Scalar";
+    }
+}
+
+bool parseSimdPath(const char* name, SimdPath& path) {
+    struct Entry { const char* name; SimdPath path; };
+    static const Entry entries[] = {
+        { "scalar", SimdPath::Scalar }, { "sse2", SimdPath::SSE2 }, { "avx2", SimdPath::AVX2 },
+        { "avx512", SimdPath::AVX512 }, { "avx-512", SimdPath::AVX512 },
+    };
+    for (const Entry& entry : entries) {
+        size_t i = 0;
+        while (entry.name[i] && name[i] && entry.name[i] == (name[i] | 0x20)) i++;
+        if (!entry.name[i] && !name[i]) {
+            path = entry.path;
+            return true;
+        }
+    }
+    return false;
+}
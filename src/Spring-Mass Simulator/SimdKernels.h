@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "SphereStore.h"
+#include "CollisionPair.h"
+
+//Vectorized kernels of the simulation step, with a scalar reference version of each.
+//The SIMD versions are compiled with per-function target attributes, so every path is in the binary whatever
+//the project-wide architecture flags are. The widest path the CPU supports is picked once at startup from CPUID,
+//the CDE_SIMD environment variable (scalar, sse2, avx2, avx512) or selectSimdPath() can force another one.
+//Every path produces the same bits as the scalar one, switching only changes the speed: SimulatorCli --check-simd
+//(and every benchmark run) compares the sphere arrays of every supported path with the scalar path's.
+//An unknown or unsupported CDE_SIMD prints a warning and keeps the best path.
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define CDE_X86 1
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+// MSVC exposes every intrinsic regardless of /arch
+#define CDE_TARGET_AVX2
+#define CDE_TARGET_AVX512
+#else
+#define CDE_TARGET_AVX2 __attribute__((target("avx2")))
+#define CDE_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+enum class SimdPath {
+    Scalar,
+    SSE2,
+    AVX2,
+    AVX512,
+};
+
+// One implementation of every vectorized kernel
+struct SimdKernelTable {
+    SimdPath path;
+
+    // Advance the spheres [begin, end) by velocity * deltaTime, then clamp every axis into
+    // [-worldSize + r, worldSize - r] and reverse the velocity component of the axes that were clamped.
+    // Returns how many components were reversed (wall bounces).
+    int (*integrate)(SphereStore& spheres, int begin, int end, float deltaTime, float worldSize);
+
+    // Write the index of every sphere in [begin, end) overlapping sphere i to hits, in order, and return how many
+    int (*overlapRow)(const SphereStore& spheres, int i, int begin, int end, uint32_t* hits);
+
+    // Narrow phase prefilter: drop the pairs whose spheres are clearly apart, keeping the order of the others,
+    // and return how many are left. Only pairs that are apart by more than contactSlack are dropped, so GJK
+    // still decides every borderline case.
+    size_t (*rejectSeparatedPairs)(const SphereStore& spheres, CollisionPair* pairs, size_t count);
+
+    // Order preserving integer keys of the endpoints of one axis: keys[i] for center[i] - radius[i] and
+    // keys[count + i] for center[i] + radius[i]. Comparing keys gives the same order as comparing the floats.
+    void (*endpointKeys)(const float* center, const float* radius, int count, uint32_t* keys);
+};
+
+// Relative margin on the squared distance before the prefilter calls a pair apart
+const float contactSlack = 1.001f;
+
+// The kernels selected for this process
+const SimdKernelTable& simdKernels();
+
+// The kernels of one path, it must be supported by this CPU
+const SimdKernelTable& simdKernelsFor(SimdPath path);
+
+bool isSimdPathSupported(SimdPath path);
+SimdPath bestSimdPath();
+
+// Force a path, returns false and keeps the current one if the CPU doesn't support it
+bool selectSimdPath(SimdPath path);
+
+const char* simdPathName(SimdPath path);
+// Parse "scalar", "sse2", "avx2" or "avx512"
+bool parseSimdPath(const char* name, SimdPath& path);
@@ -0,0 +1,196 @@
+#include "SimulationThread.h"
+#include <chrono>
+#include "Tracer.h"
+
+SimulationThread::SimulationThread()
+    : settings(), buildSettings(), rebuildPending(false), dropBuild(false), maxThroughput(false), stepCount(0),
+      lastStepMilliseconds(0.0), buildProgressValue(-1.0f), quitting(false) {
+    thread = std::thread(&SimulationThread::run, this);
+}
+
+SimulationThread::~SimulationThread() {
+    quitting.store(true, std::memory_order_release);
+    thread.join();
+}
+
+bool SimulationThread::send(const SimulationCommand& command) {
+    return commands.push(command);
+}
+
+const WorldSnapshot& SimulationThread::latestSnapshot() {
+    snapshots.acquireLatest();
+    return snapshots.readSlot();
+}
+
+void SimulationThread::run() {
+    using Clock = std::chrono::steady_clock;
+    const auto pollInterval = std::chrono::milliseconds(1);
+    Clock::time_point lastTime = Clock::now();
+    CDE_TRACE_THREAD_NAME("Simulation");
+
+    while (!quitting.load(std::memory_order_acquire)) {
+        SimulationCommand command;
+        while (commands.pop(command))
+            execute(command);
+        pollBuilder();
+
+        Clock::time_point now = Clock::now();
+        double elapsed = std::chrono::duration<double>(now - lastTime).count();
+        lastTime = now;
+        if (!world) {
+            std::this_thread::sleep_for(pollInterval);
+            continue;
+        }
+
+        // As many steps as the wall clock asks for, keep polling the commands while waiting for the next one
+        int steps = maxThroughput ? 1 : clock.advance(elapsed);
+        if (steps == 0) {
+            auto wait = std::chrono::duration<double>(clock.timeToNextStep());
+            std::this_thread::sleep_for(wait < pollInterval ? std::chrono::duration_cast<Clock::duration>(wait) : pollInterval);
+            continue;
+        }
+
+        for (int i = 0; i < steps; i++) {
+            if (i == steps - 1)
+                world->savePreviousState();
+            world->stepSimulation(clock.stepTime());
+            stepCount++;
+        }
+        lastStepMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - now).count() / steps;
+        publish();
+    }
+}
+
+void SimulationThread::execute(const SimulationCommand& command) {
+    switch (command.type) {
+    case SimulationCommand::Type::Start:
+        settings = command.settings;
+        buildWorld();
+        break;
+    case SimulationCommand::Type::Stop:
+        world.reset();
+        rebuildPending = false;
+        dropBuild = builder.busy();
+        publish();
+        break;
+    case SimulationCommand::Type::Reset:
+        if (world || builder.busy())
+            buildWorld();
+        break;
+    case SimulationCommand::Type::SetStepTime:
+        clock.setStepTime(command.stepTime);
+        break;
+    case SimulationCommand::Type::SetPacing:
+        clock.setMaxStepsPerFrame(command.maxStepsPerFrame);
+        maxThroughput = command.maxThroughput;
+        break;
+    case SimulationCommand::Type::SetMethod:
+        settings.method = command.method;
+        if (world)
+            world->collisionDetection.setMethod(command.method);
+        break;
+    case SimulationCommand::Type::SetThreads:
+        settings.numThreads = command.numThreads;
+        settings.pinThreads = command.pinThreads;
+        if (world)
+            world->setThreadCount(command.numThreads, command.pinThreads);
+        break;
+    case SimulationCommand::Type::ResetWorkerStats:
+        if (world)
+            world->jobSystem.resetStats();
+        break;
+    }
+}
+
+// A new world instead of resetting the current one in place: the render thread may still be reading the
+// current world's generation and scenario from an older snapshot, so they must stay untouched until it is released
+void SimulationThread::buildWorld() {
+    dropBuild = false;
+    if (builder.busy()) {
+        rebuildPending = true;
+        return;
+    }
+    buildSettings = settings;
+    builder.start(buildSettings);
+    buildProgressValue.store(0.0f, std::memory_order_relaxed);
+}
+
+// Swap in the world being built once it is ready
+void SimulationThread::pollBuilder() {
+    if (!builder.busy())
+        return;
+
+    std::unique_ptr<SimulatorWorld> built = builder.take();
+    if (!built) {
+        buildProgressValue.store(builder.progress(), std::memory_order_relaxed);
+        return;
+    }
+    buildProgressValue.store(-1.0f, std::memory_order_relaxed);
+    if (rebuildPending) {
+        rebuildPending = false;
+        buildWorld();
+        return;
+    }
+    if (dropBuild) {
+        dropBuild = false;
+        return;
+    }
+
+    // Commands that arrived during the build only changed the settings
+    if (settings.method != buildSettings.method)
+        built->collisionDetection.setMethod(settings.method);
+    if (settings.numThreads != buildSettings.numThreads || settings.pinThreads != buildSettings.pinThreads)
+        built->setThreadCount(settings.numThreads, settings.pinThreads);
+
+    world = std::move(built);
+    stepCount = 0;
+    lastStepMilliseconds = 0.0;
+    clock.reset();
+    publish();
+}
+
+// Copy the state of every sphere, the culling is left to the thread drawing them
+void SimulationThread::gatherSpheres(WorldSnapshot& snapshot) {
+    CDE_TRACE_SCOPE("Gather spheres");
+    const SphereStore& spheres = world->spheres;
+    int count = spheres.size();
+    snapshot.spheres.resize(count);
+    snapshot.previousCenters.resize(count);
+    snapshot.ids.resize(count);
+    world->jobSystem.parallelFor(0, count, gatherGrainSize, [&](int begin, int end, int) {
+        for (int i = begin; i < end; i++) {
+            snapshot.spheres[i].center = glm::vec3(spheres.centerX[i], spheres.centerY[i], spheres.centerZ[i]);
+            snapshot.spheres[i].radius = spheres.radius[i];
+            snapshot.previousCenters[i] = glm::vec3(world->previousCenterX[i], world->previousCenterY[i], world->previousCenterZ[i]);
+            snapshot.ids[i] = spheres.id[i];
+        }
+    });
+}
+
+void SimulationThread::publish() {
+    CDE_TRACE_SCOPE("Publish snapshot");
+    WorldSnapshot& snapshot = snapshots.writeSlot();
+    snapshot.world = world;
+    if (world) {
+        gatherSpheres(snapshot);
+        snapshot.index = world->collisionDetection.spatialIndex(); // Reuses the slot's storage
+        snapshot.arenaHighWaterMark = world->frameArenas.totalHighWaterMark();
+        snapshot.workerStats = world->jobSystem.stats();
+        snapshot.phaseStats = world->stats.average();
+    } else {
+        snapshot.spheres.clear();
+        snapshot.previousCenters.clear();
+        snapshot.ids.clear();
+        snapshot.index.valid = false;
+        snapshot.arenaHighWaterMark = 0;
+        snapshot.workerStats.clear();
+        snapshot.phaseStats = StepStats();
+    }
+    snapshot.step = stepCount;
+    snapshot.stepMilliseconds = lastStepMilliseconds;
+    snapshot.droppedSteps = clock.droppedSteps();
+    snapshot.publishTime = std::chrono::steady_clock::now();
+    snapshot.stepTime = clock.stepTime();
+    snapshot.interpolate = !maxThroughput;
+    snapshots.publish();
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "FixedStepClock.h"
+#include "SimulatorWorld.h"
+#include "SpscQueue.h"
+#include "TripleBuffer.h"
+#include "WorldBuilder.h"
+
+//Runs the simulation on its own thread, so a slow step doesn't lower the frame rate and a slow frame doesn't slow
+//down the simulation. The UI sends commands through a lock-free queue, the simulation thread executes them between
+//two steps, and after every step it publishes the state to draw into a triple buffer. The render thread takes the
+//latest complete snapshot from there without ever locking or waiting for the simulator.
+//New worlds are built in the background by a WorldBuilder, the current world keeps running until the new one is ready.
+
+struct SimulationCommand {
+    enum class Type {
+        Start,            // Build a new world from settings and run it once it is ready
+        Stop,             // Drop the world, and the one being built
+        Reset,            // Build the world again from the last settings
+        SetStepTime,      // Simulated seconds per step, also the wall clock time between two steps
+        SetPacing,        // Cap of steps run to catch up with the wall clock, or run steps back to back
+        SetMethod,        // Switch the broad phase method
+        SetThreads,       // Restart the world's job system
+        ResetWorkerStats
+    };
+
+    Type type;
+    WorldSettings settings; // Start
+    float stepTime;         // SetStepTime
+    int maxStepsPerFrame;   // SetPacing
+    bool maxThroughput;     // SetPacing
+    int method;             // SetMethod
+    int numThreads;         // SetThreads
+    bool pinThreads;        // SetThreads
+};
+
+// Position and size of a sphere in a snapshot
+struct SphereState {
+    glm::vec3 center;
+    float radius;
+};
+
+// A completed state of the simulation, everything the render thread and the UI read from it
+struct WorldSnapshot {
+    // World of the snapshot, for its generation and scenario settings: they don't change while the world steps, so
+    // the render thread can build the world's render data from them. Null when stopped.
+    std::shared_ptr<const SimulatorWorld> world;
+    std::vector<SphereState> spheres;    // Every sphere, not culled yet
+    std::vector<glm::vec3> previousCenters; // Centers before the last step, to interpolate from
+    std::vector<int> ids;                // Sphere id of each instance
+    SpatialIndex index;                  // Broad phase index of the spheres, to cull without visiting all of them
+    uint64_t step = 0;                   // Steps run by this world
+    double stepMilliseconds = 0.0;       // Average duration of the steps run since the previous snapshot
+    long long droppedSteps = 0;          // Steps skipped because the simulation couldn't keep up with the wall clock
+    size_t arenaHighWaterMark = 0;
+    std::vector<WorkerStats> workerStats;
+    StepStats phaseStats = {};           // Average phases and counters of the world's last steps
+
+    std::chrono::steady_clock::time_point publishTime;
+    float stepTime = 0.016f;
+    bool interpolate = false; // False when running steps back to back, the latest state is drawn as is
+
+    // The next snapshot is due one step after this one, draw the state that far in between the last two steps
+    float interpolationAlpha(std::chrono::steady_clock::time_point now) const {
+        if (!interpolate)
+            return 1.0f;
+        float alpha = std::chrono::duration<float>(now - publishTime).count() / stepTime;
+        return alpha < 0.0f ? 0.0f : (alpha < 1.0f ? alpha : 1.0f);
+    }
+};
+
+class SimulationThread
+{
+public:
+    SimulationThread();
+    ~SimulationThread(); // Stops the thread after the step in progress
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    // UI thread only, returns false if the queue is full: the command wasn't queued, send it again later
+    bool send(const SimulationCommand& command);
+
+    // Render thread only, the latest published snapshot, valid until the next call
+    const WorldSnapshot& latestSnapshot();
+
+    // Share of the spheres of the world being built, negative when no world is being built
+    float buildProgress() const {
+        return buildProgressValue.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr int commandCapacity = 64;
+    static constexpr int gatherGrainSize = 4096; // Spheres per chunk of gatherSpheres
+
+    SpscQueue<SimulationCommand, commandCapacity> commands;
+    TripleBuffer<WorldSnapshot> snapshots;
+
+    // Only touched by the simulation thread
+    std::shared_ptr<SimulatorWorld> world;
+    WorldSettings settings;
+    WorldSettings buildSettings; // Settings of the world being built
+    WorldBuilder builder;
+    bool rebuildPending;         // Settings changed while building, build again once the running build ends
+    bool dropBuild;              // The world being built was stopped before it was ready
+    FixedStepClock clock;
+    bool maxThroughput;
+    uint64_t stepCount;
+    double lastStepMilliseconds;
+
+    std::atomic<float> buildProgressValue;
+    std::atomic<bool> quitting;
+    std::thread thread;
+
+    void run();
+    void execute(const SimulationCommand& command);
+    void buildWorld();
+    void pollBuilder();
+    void publish();
+    void gatherSpheres(WorldSnapshot& snapshot);
+};
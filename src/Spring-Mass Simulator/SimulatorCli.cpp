@@ -0,0 +1,202 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "SimulatorWorld.h"
+#include "SimdKernels.h"
+#include "PerformanceAnalysis.h"
+#include "Scenario.h"
+#include "Tracer.h"
+
+//Headless runner: builds a scene from the command line, steps it and reports the throughput.
+//It only links the simulation core (SimulationCore), no window, OpenGL or UI, so it runs on servers without a display.
+//With --benchmark it runs the steady-state benchmark of PerformanceAnalysis instead, see BenchmarkOptions.
+
+namespace {
+    void printUsage() {
+        std::cout << "Usage: SimulatorCli [options]\n"
+                  << "  --spheres N          Number of spheres (1000)\n"
+                  << "  --steps N            Steps to run (1000)\n"
+                  << "  --dt SECONDS         Duration of a step (0.016)\n"
+                  << "  --method M           Broad phase: 0 sweep and prune, 1 brute force (0)\n"
+                  << "  --threads N          Worker threads, 0 uses every hardware thread (0)\n"
+                  << "  --pin                Pin the workers to cores\n"
+                  << "  --seed S             Random seed of the scene (1)\n"
+                  << "  --radius MIN MAX     Radius range (0.2 3)\n"
+                  << "  --velocity MIN MAX   Velocity range of each axis (-5 5)\n"
+                  << "  --mass MIN MAX       Mass range (0.5 10)\n"
+                  << "  --world-size SIZE    Half extent of the world cube (20)\n"
+                  << "  --scenario NAME      Scene generator (uniform), with --benchmark only that one in the scenario experiment\n"
+                  << "  --benchmark          Run every benchmark experiment instead, --steps are its measured steps (200),\n"
+                  << "                       --threads, --pin, --seed and --dt apply to it too\n"
+                  << "  --warmup N           Benchmark steps run before measuring (20)\n"
+                  << "  --check-simd         Run the scene with every supported SIMD path instead and check that they all\n"
+                  << "                       give the scalar path's bits, --steps are the steps compared (100)\n"
+                  << "  --trace FILE         Record the phases and jobs of every thread, written to FILE as a Chrome trace\n"
+                  << "                       (the last " << Tracer::eventsPerThread << " events of each thread)\n"
+                  << "Scenarios:\n";
+        for (int i = 0; i < scenarioCount(); i++)
+            std::printf("  %-20s %s\n", scenarioAt(i).name, scenarioAt(i).description);
+    }
+
+    // Write the recorded timeline, if --trace asked for one
+    void writeTrace(const char* path) {
+        if (!path)
+            return;
+        Tracer::setRecording(false);
+        if (Tracer::writeChromeTrace(path))
+            std::cout << "Trace written to " << path << std::endl;
+        else
+            std::cerr << "Could not write the trace to " << path << std::endl;
+    }
+
+    // Value i of option, exits with the usage when it is missing
+    const char* optionValue(int argc, char** argv, int& i) {
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << argv[i] << std::endl;
+            printUsage();
+            std::exit(1);
+        }
+        return argv[++i];
+    }
+}
+
+int main(int argc, char** argv) {
+    WorldSettings settings;
+    settings.numSpheres = 1000;
+    settings.minRadius = 0.2f;
+    settings.maxRadius = 3.0f;
+    settings.minVelocity = -5.0f;
+    settings.maxVelocity = 5.0f;
+    settings.minMass = 0.5f;
+    settings.maxMass = 10.0f;
+    settings.worldSize = 20.0f;
+    settings.seed = 1;
+    settings.method = 0;
+    settings.numThreads = 0;
+    settings.pinThreads = false;
+    settings.headless = true; // Nothing is drawn, the broad phase keeps no spatial index
+    settings.scenario = 0;
+    bool scenarioGiven = false;
+    int steps = -1; // Unset, 1000, the benchmark's 200 or the parity check's 100
+    float stepTime = 0.016f;
+    bool benchmark = false;
+    int warmupSteps = 20;
+    bool checkSimd = false;
+    const char* tracePath = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        if (std::strcmp(option, "--spheres") == 0) {
+            settings.numSpheres = std::atoi(optionValue(argc, argv, i));
+        } else if (std::strcmp(option, "--steps") == 0) {
+            steps = std::atoi(optionValue(argc, argv, i));
+        } else if (std::strcmp(option, "--dt") == 0) {
+            stepTime = static_cast<float>(std::atof(optionValue(argc, argv, i)));
+        } else if (std::strcmp(option, "--method") == 0) {
+            settings.method = std::atoi(optionValue(argc, argv, i));
+        } else if (std::strcmp(option, "--threads") == 0) {
+            settings.numThreads = std::atoi(optionValue(argc, argv, i));
+        } else if (std::strcmp(option, "--pin") == 0) {
+            settings.pinThreads = true;
+        } else if (std::strcmp(option, "--seed") == 0) {
+            settings.seed = std::strtoull(optionValue(argc, argv, i), nullptr, 10);
+        } else if (std::strcmp(option, "--radius") == 0) {
+            settings.minRadius = static_cast<float>(std::atof(optionValue(argc, argv, i)));
+            settings.maxRadius = static_cast<float>(std::atof(optionValue(argc, argv, i)));
+        } else if (std::strcmp(option, "--velocity") == 0) {
+            settings.minVelocity = static_cast<float>(std::atof(optionValue(argc, argv, i)));
+            settings.maxVelocity = static_cast<float>(std::atof(optionValue(argc, argv, i)));
+        } else if (std::strcmp(option, "--mass") == 0) {
+            settings.minMass = static_cast<float>(std::atof(optionValue(argc, argv, i)));
+            settings.maxMass = static_cast<float>(std::atof(optionValue(argc, argv, i)));
+        } else if (std::strcmp(option, "--world-size") == 0) {
+            settings.worldSize = static_cast<float>(std::atof(optionValue(argc, argv, i)));
+        } else if (std::strcmp(option, "--scenario") == 0) {
+            const char* name = optionValue(argc, argv, i);
+            settings.scenario = findScenario(name);
+            if (settings.scenario < 0) {
+                std::cerr << "Unknown scenario " << name << std::endl;
+                printUsage();
+                return 1;
+            }
+            scenarioGiven = true;
+        } else if (std::strcmp(option, "--benchmark") == 0) {
+            benchmark = true;
+        } else if (std::strcmp(option, "--warmup") == 0) {
+            warmupSteps = std::atoi(optionValue(argc, argv, i));
+        } else if (std::strcmp(option, "--check-simd") == 0) {
+            checkSimd = true;
+        } else if (std::strcmp(option, "--trace") == 0) {
+            tracePath = optionValue(argc, argv, i);
+        } else if (std::strcmp(option, "--help") == 0 || std::strcmp(option, "-h") == 0) {
+            printUsage();
+            return 0;
+        } else {
+            std::cerr << "Unknown option " << option << std::endl;
+            printUsage();
+            return 1;
+        }
+    }
+    if (steps == -1)
+        steps = benchmark ? 200 : (checkSimd ? 100 : 1000);
+    if (settings.numSpheres < 0 || steps < 0 || warmupSteps < 0 || (settings.method != 0 && settings.method != 1)) {
+        std::cerr << "Invalid options" << std::endl;
+        printUsage();
+        return 1;
+    }
+
+    if (tracePath) {
+#if !CDE_ENABLE_TRACE
+        std::cerr << "Built without CDE_ENABLE_TRACE, the trace will be empty" << std::endl;
+#endif
+        CDE_TRACE_THREAD_NAME("Main");
+        Tracer::setRecording(true);
+    }
+
+    if (checkSimd)
+        return checkSimdParity(settings, steps, stepTime) ? 0 : 1;
+
+    if (benchmark) {
+        BenchmarkOptions options;
+        options.warmupSteps = warmupSteps;
+        options.measuredSteps = steps;
+        options.stepTime = stepTime;
+        options.numThreads = settings.numThreads;
+        options.pinThreads = settings.pinThreads;
+        options.seed = settings.seed;
+        options.scenario = scenarioGiven ? settings.scenario : -1;
+        int result = runPerformanceAnalysis(options);
+        writeTrace(tracePath);
+        return result;
+    }
+
+    auto buildStart = std::chrono::steady_clock::now();
+    SimulatorWorld world(settings);
+    double buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - buildStart).count();
+
+    std::cout << "Scenario: " << scenarioAt(settings.scenario).name << ", spheres: " << settings.numSpheres << ", method: " << settings.method << ", seed: " << settings.seed
+              << ", workers: " << world.jobSystem.numWorkers() << (world.jobSystem.threadsPinned() ? " (pinned)" : "")
+              << ", SIMD path: " << simdPathName(simdKernels().path) << std::endl;
+    std::printf("Built the world in %.1f ms\n", buildSeconds * 1000.0);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; step++)
+        world.stepSimulation(stepTime);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double stepsPerSecond = seconds > 0.0 ? steps / seconds : 0.0;
+    std::printf("%d steps in %.3f s: %.1f steps/s, %.4g sphere-steps/s\n", steps, seconds, stepsPerSecond,
+                stepsPerSecond * settings.numSpheres);
+#if CDE_ENABLE_STATS
+    StepStats average = world.stats.average();
+    std::printf("Last %d steps: broad %.3f ms, narrow %.3f ms, response %.3f ms, integration %.3f ms\n",
+                world.stats.count(), StepStats::toMs(average.broadNs),
+                StepStats::toMs(average.narrowNs), StepStats::toMs(average.responseNs), StepStats::toMs(average.integrationNs));
+    std::printf("  %.1f candidate pairs, %.1f colliding, %.1f GJK iterations, %.1f wall bounces per step\n",
+                average.candidatePairs, average.confirmedPairs, average.gjkIterations, average.wallBounces);
+#endif
+    writeTrace(tracePath);
+    return 0;
+}
@@ -5,21 +5,20 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#include <GL/glew.h>
-#include <GLFW/glfw3.h>
 #include <vector>
-#include <ctime>   // For time()
 #include <algorithm> // For std::min and std::max
 #include <iostream> // For std::cout and std::endl
 #include <stdexcept> // For std::runtime_error
 #include <cmath> // For std::sqrt and std::pow
 #include <limits> // For std::numeric_limits
-#include "Utils.h"
 #include "CollisionDetection.h"
+#include "ResourceGeneration.h"
+#include "SimdKernels.h"
+#include "CounterRng.h"
+#include "Scenario.h"
+#include "Tracer.h"
 
 SimulatorWorld::SimulatorWorld(
-    const int minComplexity,
-    const int maxComplexity,
     const int numSpheres,
     const float minRadius,
     const float maxRadius,
@@ -27,154 +26,160 @@ SimulatorWorld::SimulatorWorld(
     const float maxVelocity,
     const float minMass,
     const float maxMass,
-    const float worldSize
-) : minComplexity(minComplexity),
-maxComplexity(maxComplexity),
-numSpheres(numSpheres),
-minRadius(minRadius),
-maxRadius(maxRadius),
-minVelocity(minVelocity),
-maxVelocity(maxVelocity),
-minMass(minMass),
-maxMass(maxMass),
-worldSize(worldSize) {
-
-    // Initialize random seed
-    srand(static_cast<unsigned int>(time(0)));
+    const float worldSize,
+    const uint64_t seed
+) : SimulatorWorld(WorldSettings{ numSpheres, minRadius, maxRadius,
+        minVelocity, maxVelocity, minMass, maxMass, worldSize, seed, 0, 0, false, false, 0 }) {
+}
+
+SimulatorWorld::SimulatorWorld(const WorldSettings& settings, std::atomic<int>* progress)
+: jobSystem(settings.numThreads, settings.pinThreads),
+collisionDetection(&spheres, settings.worldSize, settings.method),
+generation(0),
+numSpheres(settings.numSpheres),
+minRadius(settings.minRadius),
+maxRadius(settings.maxRadius),
+minVelocity(settings.minVelocity),
+maxVelocity(settings.maxVelocity),
+minMass(settings.minMass),
+maxMass(settings.maxMass),
+worldSize(settings.worldSize),
+seed(settings.seed),
+scenario(settings.scenario),
+gravity(scenarioAt(settings.scenario).gravity) {
 
     // Allocate memory for spheres
-    spheres = new SphereBV[numSpheres]; // Allocate memory for the spheres array
-    CubeWorldPosition = nullptr; // Initialize CubeWorldPosition to nullptr
+    spheres.reserve(numSpheres); // Reserve memory for the sphere arrays
+    frameArenas.resize(CollisionDetection::requiredArenas(jobSystem.numWorkers()));
+    collisionDetection.setKeepSpatialIndex(!settings.headless); // Only a world that is drawn queries it
 
     // Initialize the simulation world
-    initializeWorld();
-}
-
-SimulatorWorld::~SimulatorWorld() {
-    delete[] spheres;
-    delete[] CubeWorldPosition;
+    initializeWorld(progress);
 }
 
-void SimulatorWorld::initializeWorld() {
-    // Initialize the world boundary
-    initializeWorldBoundary();
-
-    // Create a Utils instance for random number generation
-    Utils utils;
+void SimulatorWorld::initializeWorld(std::atomic<int>* progress) {
+    // Drop the spheres of a previous initialization
+    spheres.clear();
+    collisionDetection.spatialIndex().valid = false; // Sorted for the old spheres, the next broad phase sorts again
+    spheres.resize(numSpheres);
 
     //Inmitialize the simulation world with spheres
-    for (int i = 0; i < numSpheres; i++) {
-        // Random center within cubic worldsize (default world centered at origin)
-        float minBoundary = -worldSize;
-        float maxBoundary = worldSize;
-        glm::vec3 center = glm::vec3(
-            utils.randomFloat(minBoundary, maxBoundary),
-            utils.randomFloat(minBoundary, maxBoundary),
-            utils.randomFloat(minBoundary, maxBoundary)
-        );
-
-        // Generate random radius
-        float radius = utils.randomFloat(minRadius, maxRadius);
-
-        // Generate random velocity in the given range
-        glm::vec3 velocity = glm::vec3(
-            utils.randomFloat(minVelocity, maxVelocity),
-            utils.randomFloat(minVelocity, maxVelocity),
-            utils.randomFloat(minVelocity, maxVelocity)
-        );
-
-        // Generate random mass
-        float mass = utils.randomFloat(minMass, maxMass);
-
-        // Generate random complexity for lathing
-        int complexity = utils.randomInt(minComplexity, maxComplexity);
-
-        // Generate color based on radius, mass, and velocity
-        glm::vec3 color;
-        float red = std::min(1.0f, radius / maxRadius);        // Higher radius, more red
-        float blue = std::min(1.0f, mass / maxMass);             // Higher mass, more blue
-        float velocityMagnitude = glm::length(velocity);
-        float yellow = std::min(1.0f, velocityMagnitude / maxVelocity); // Higher velocity, more yellow
-        color.r = red;
-        color.g = yellow;
-        color.b = blue;
-
-        // Create the sphere
-        spheres[i] = SphereBV(center, radius, velocity, mass, complexity, color, i);
-    }
+    //Each sphere draws from its own random stream, so the scene only depends on the seed and not on the workers
+    const Scenario& generator = scenarioAt(scenario);
+    const ScenarioSettings settings = scenarioSettings();
+    jobSystem.parallelFor(0, numSpheres, sceneGrainSize, [&](int begin, int end, int) {
+        for (int i = begin; i < end; i++) {
+            CounterRng rng(seed, static_cast<uint64_t>(i));
+            ScenarioSphere sphere = generator.generate(settings, i, rng);
+            spheres.setSphere(i, sphere.center, sphere.radius, sphere.velocity, sphere.mass, i);
+        }
+        if (progress)
+            progress->fetch_add(end - begin, std::memory_order_relaxed);
+    });
+
+    // Nothing to interpolate from yet, nor to average
+    savePreviousState();
+    stats.clear();
+    generation = nextResourceGeneration();
 }
 
-void SimulatorWorld::initializeWorldBoundary() {
-
-    // Initialize the world boundary as a cube with vertices at the corners of the cube
-    cubicWorldVertices.clear();
-    CubeWorldPosition = new glm::vec3[8]; // Allocate memory for the cube vertices
-    CubeWorldPosition[0] = glm::vec3(-worldSize, -worldSize, -worldSize); // Bottom-left-back
-    CubeWorldPosition[1] = glm::vec3(worldSize, -worldSize, -worldSize); // Bottom-right-back
-    CubeWorldPosition[2] = glm::vec3(worldSize, worldSize, -worldSize); // Top-right-back
-    CubeWorldPosition[3] = glm::vec3(-worldSize, worldSize, -worldSize); // Top-left-back
-    CubeWorldPosition[4] = glm::vec3(-worldSize, -worldSize, worldSize); // Bottom-left-front
-    CubeWorldPosition[5] = glm::vec3(worldSize, -worldSize, worldSize); // Bottom-right-front
-    CubeWorldPosition[6] = glm::vec3(worldSize, worldSize, worldSize); // Top-right-front
-    CubeWorldPosition[7] = glm::vec3(-worldSize, worldSize, worldSize); // Top-left-front
-    
-    //Unify the cube vertices to the same color
-    glm::vec3 color(1.0f, 1.0f, 1.0f); // White color
-    for (int i = 0; i < 8; i++) {
-        vertice v;
-        v.pos = CubeWorldPosition[i];
-        v.color = color;
-        cubicWorldVertices.push_back(v); // Add vertex to the mesh
-    }
-
-    // Use explicit edge indices for a wireframe cube
-    indices.clear();
-    indices = {
-        0,1, 1,2, 2,3, 3,0,   // back face
-        4,5, 5,6, 6,7, 7,4,   // front face
-        0,4, 1,5, 2,6, 3,7    // connecting edges
-    };
+ScenarioSettings SimulatorWorld::scenarioSettings() const {
+    return { numSpheres, minRadius, maxRadius, minVelocity, maxVelocity, minMass, maxMass, worldSize, seed };
 }
 
 void SimulatorWorld::stepSimulation(float deltaTime) {
-    //Collision detection and response
-    //Queue structure to store pairs of spheres that are colliding
-    std::vector<std::pair<SphereBV*, SphereBV*>> collisionPairs;
+    // Timings and counters of this step, added to stats at the end (see StepStats.h)
+    CDE_STATS(StepStats step = {});
+    CDE_TRACE_SCOPE("Step");
 
+    //Collision detection and response
     // Check for collisions between spheres and handle them
-    CollisionDetection collisionDetection(spheres, numSpheres, worldSize, &collisionPairs);
-    collisionDetection.broadCollisionDetection(); // Perform broad phase collision detection
-    collisionDetection.narrowCollisionDetection(); // Perform narrow phase collision detection
-    collisionDetection.handleCollision(); // Handle collisions by reversing velocities
-
-    // Update the position of each sphere based on its velocity and delta time
-    for (int i = 0; i < numSpheres; i++) {
-        spheres[i].center += spheres[i].velocity * deltaTime;
-        // Update transformation: include both translation and scaling
-        spheres[i].transform = glm::translate(glm::mat4(1.0f), spheres[i].center) *
-                                glm::scale(glm::mat4(1.0f), glm::vec3(spheres[i].radius));
+    {
+        CDE_STATS_SCOPE(step.broadNs);
+        CDE_TRACE_SCOPE("Broad phase");
+        // Release the temporaries of the previous step
+        frameArenas.resetAll(jobSystem.numWorkers());
+        collisionDetection.beginStep(&frameArenas, &jobSystem);
+        collisionDetection.broadCollisionDetection(); // Perform broad phase collision detection
     }
+    CDE_STATS(step.candidatePairs = static_cast<double>(collisionDetection.getCollisionPairs().size()));
+    {
+        CDE_STATS_SCOPE(step.narrowNs);
+        CDE_TRACE_SCOPE("Narrow phase");
+        collisionDetection.narrowCollisionDetection(); // Perform narrow phase collision detection
+    }
+    CDE_STATS(step.confirmedPairs = static_cast<double>(collisionDetection.getCollisionPairs().size()));
+    CDE_STATS(step.gjkIterations = static_cast<double>(collisionDetection.gjkIterations()));
+    {
+        CDE_STATS_SCOPE(step.responseNs);
+        CDE_TRACE_SCOPE("Collision response");
+        collisionDetection.handleCollision(); // Handle collisions by reversing velocities
+    }
+
+    // Update the position of each sphere based on its velocity and delta time (after the scenario's gravity, if any,
+    // changed the velocity), then keep it inside the world by reflecting it at the walls
+    // With a spatial index kept for the renderer, each chunk also records its fastest speed along each axis while
+    // its velocities are still in cache: that bounds how far a sphere went since the broad phase sorted them
+    {
+        CDE_STATS_SCOPE(step.integrationNs);
+        CDE_TRACE_SCOPE("Integration");
+        const SimdKernelTable& kernels = simdKernels();
+        SpatialIndex& index = collisionDetection.spatialIndex();
+        int numChunks = (spheres.size() + integrationGrainSize - 1) / integrationGrainSize;
+        if (index.valid)
+            chunkMaxSpeeds.resize(numChunks);
+        chunkWallBounces.resize(numChunks);
+        const bool accelerated = gravity != glm::vec3(0.0f);
+        jobSystem.parallelFor(0, spheres.size(), integrationGrainSize, [&](int begin, int end, int) {
+            if (accelerated)
+                spheres.accelerate(begin, end, gravity * deltaTime);
+            chunkWallBounces[begin / integrationGrainSize] = kernels.integrate(spheres, begin, end, deltaTime, worldSize);
+            if (!index.valid)
+                return;
+            glm::vec3 maxSpeed(0.0f);
+            for (int i = begin; i < end; i++) {
+                maxSpeed.x = std::max(maxSpeed.x, std::fabs(spheres.velocityX[i]));
+                maxSpeed.y = std::max(maxSpeed.y, std::fabs(spheres.velocityY[i]));
+                maxSpeed.z = std::max(maxSpeed.z, std::fabs(spheres.velocityZ[i]));
+            }
+            chunkMaxSpeeds[begin / integrationGrainSize] = maxSpeed;
+        });
+
+        if (index.valid) {
+            glm::vec3 maxSpeed(0.0f);
+            for (int chunk = 0; chunk < numChunks; chunk++)
+                maxSpeed = glm::max(maxSpeed, chunkMaxSpeeds[chunk]);
+            index.slack = maxSpeed * deltaTime;
+        }
+        CDE_STATS(for (int chunk = 0; chunk < numChunks; chunk++) step.wallBounces += chunkWallBounces[chunk]);
+    }
+    CDE_STATS(stats.add(step));
+}
+
+void SimulatorWorld::setThreadCount(int numThreads, bool pinThreads) {
+    jobSystem.restart(numThreads, pinThreads);
+    frameArenas.resize(CollisionDetection::requiredArenas(jobSystem.numWorkers()));
+}
+
+void SimulatorWorld::savePreviousState() {
+    int count = spheres.size();
+    previousCenterX.resize(count);
+    previousCenterY.resize(count);
+    previousCenterZ.resize(count);
+    jobSystem.parallelFor(0, count, copyGrainSize, [&](int begin, int end, int) {
+        std::copy(spheres.centerX.begin() + begin, spheres.centerX.begin() + end, previousCenterX.begin() + begin);
+        std::copy(spheres.centerY.begin() + begin, spheres.centerY.begin() + end, previousCenterY.begin() + begin);
+        std::copy(spheres.centerZ.begin() + begin, spheres.centerZ.begin() + end, previousCenterZ.begin() + begin);
+    });
 }
 
 void SimulatorWorld::stopSimulation() {
     // Stop the simulation and clean up resources
-    delete[] spheres; // Free the memory allocated for spheres
-    spheres = nullptr; // Set pointer to nullptr to avoid dangling pointer
-    delete[] CubeWorldPosition; // Free the memory allocated for CubeWorldPosition
-    CubeWorldPosition = nullptr; // Set pointer to nullptr to avoid dangling pointer
-    cubicWorldVertices.clear(); // Clear the vertices of the cubic world
+    spheres.clear(); // Remove all spheres from the store
 }
 
 // Reset the simulation to its initial state
 void SimulatorWorld::resetSimulation() {
-    // Clean up existing spheres to prevent memory leaks
-    for (int i = 0; i < numSpheres; i++) {
-        if (spheres[i].mesh) {
-            delete spheres[i].mesh;
-            spheres[i].mesh = nullptr;
-        }
-    }
-    
     // Reset the simulation by reinitializing the world
     initializeWorld(); // Reinitialize the world with new spheres
 }
@@ -183,8 +188,8 @@ void SimulatorWorld::resetSimulation() {
 void SimulatorWorld::render() {
     // Render the simulation world and spheres
     // Simple debug output
-    for (int i = 0; i < numSpheres; i++) {
-        std::cout << "Sphere " << i << ": Position = (" << spheres[i].center.x << ", " << spheres[i].center.y << ", " << spheres[i].center.z << ")" << std::endl;
+    for (int i = 0; i < spheres.size(); i++) {
+        std::cout << "Sphere " << i << ": Position = (" << spheres.centerX[i] << ", " << spheres.centerY[i] << ", " << spheres.centerZ[i] << ")" << std::endl;
     }
 }
 
@@ -1,18 +1,43 @@
 #pragma once
 #include <glm/glm.hpp>
 #include "SphereBV.h"
-#include "SphereMesh.h"
+#include "SphereStore.h"
+#include <atomic>
+#include <cstdint>
 #include <vector>
 #include "CollisionDetection.h"
+#include "FrameArena.h"
+#include "JobSystem.h"
+#include "Scenario.h"
+#include "StepStats.h"
+
+// Everything a SimulatorWorld is built from
+struct WorldSettings {
+    int numSpheres;
+    float minRadius;
+    float maxRadius;
+    float minVelocity;
+    float maxVelocity;
+    float minMass;
+    float maxMass;
+    float worldSize;
+    uint64_t seed;   // Random seed of the scene
+    int method;      // Broad phase method, see CollisionDetection::setMethod
+    int numThreads;  // Workers of the world's job system, 0 uses every hardware thread
+    bool pinThreads;
+    bool headless;   // Nothing draws the world, the broad phase keeps no spatial index for culling
+    int scenario;    // Index of the scene generator, see scenarioAt, 0 is the uniform gas
+};
+
+//The physics of one scene: the spheres, the collision pipeline and the workers stepping them.
+//Nothing here knows how the spheres are drawn, the app keeps their render data next to the world (see
+//WorldRenderData.h) and rebuilds it whenever generation changes.
 
 class SimulatorWorld
 {
 public:
     //INitializes the simulator world from UI input
-    //complexityLevel: 0 = simple, 1 = medium, 2 = complex
     SimulatorWorld(
-        const int minComplexity,
-        const int maxComplexity,
         const int numSpheres,
         const float minRadius,
         const float maxRadius,
@@ -20,32 +45,46 @@ public:
         const float maxVelocity,
         const float minMass,
         const float maxMass,  // Added missing comma here
-        const float worldSize // The max boundary in positive + axis
+        const float worldSize, // The max boundary in positive + axis
+        const uint64_t seed = 1 // Same seed, same scene, see CounterRng
     );
-    
-    // Add destructor declaration
-    ~SimulatorWorld();
+
+    // Build the world from settings, progress (if any) counts the spheres created so far, from any thread
+    explicit SimulatorWorld(const WorldSettings& settings, std::atomic<int>* progress = nullptr);
     
     // Make these members public so they can be accessed from main
-    SphereBV* spheres;  // Array of spheres in the simulation
-    glm::vec3* CubeWorldPosition;  // Add missing declaration for CubeWorldPosition
-    
-    // Bounding box of the simulation world
-    std::vector<vertice> cubicWorldVertices; 
-    std::vector<int> indices;
+    SphereStore spheres;  // Structure-of-arrays store of the spheres in the simulation
+    JobSystem jobSystem; // Worker threads running the phases of a step
+    FrameArenaPool frameArenas; // Per-worker (and per sweep axis) arenas for the temporaries of a step, reset at the start of every step
+    CollisionDetection collisionDetection; // Collision pipeline, kept alive across steps
+    // Sphere centers saved by savePreviousState, the rendered state is interpolated from them to the current ones
+    std::vector<float> previousCenterX;
+    std::vector<float> previousCenterY;
+    std::vector<float> previousCenterZ;
+    uint64_t generation; // Stamp of the scene, renewed by every initializeWorld (see ResourceGeneration.h)
 
     int numSpheres;
+    StepStatsWindow stats; // Timings and counters of the last steps, empty in builds without CDE_ENABLE_STATS
 
-    void initializeWorld(); // Initialize the simulation world with spheres and their properties
+    void initializeWorld(std::atomic<int>* progress = nullptr); // Initialize the simulation world with spheres and their properties, progress counts the spheres done
     void stepSimulation(float deltaTime);
     void stopSimulation(); // Stop the simulation and clean up resources
     void resetSimulation(); // Reset the simulation to its initial state
-    void render(); // Render the simulation world
-    void initializeWorldBoundary(); // Made public to access from main
+    void savePreviousState(); // Keep the current centers to interpolate from, called before the last step of a frame
+    void render(); // Print the sphere positions
+    void setThreadCount(int numThreads, bool pinThreads); // Restart the job system, 0 threads uses every hardware thread
+    uint64_t getSeed() const { return seed; }
+    int getScenario() const { return scenario; }
+    float getWorldSize() const { return worldSize; }
+    void setSeed(uint64_t newSeed) { seed = newSeed; } // Used by the next initializeWorld
+    // Ranges and seed the current spheres were generated from, replaying the scenario with them gives their initial state
+    ScenarioSettings scenarioSettings() const;
 
 private:
-    int minComplexity;
-    int maxComplexity;     
+    static constexpr int integrationGrainSize = 4096; // Spheres per integration chunk, a multiple of every SIMD width
+    static constexpr int sceneGrainSize = 1024;       // Spheres per chunk of initializeWorld
+    static constexpr int copyGrainSize = 4096;        // Spheres per chunk of savePreviousState
+
     float minRadius;    
     float maxRadius;    
     float minVelocity;  
@@ -53,5 +92,9 @@ private:
     float minMass;     
     float maxMass;
     float worldSize;    
+    uint64_t seed;
+    int scenario;
+    glm::vec3 gravity; // Of the scenario, added to the velocities at every step
+    std::vector<glm::vec3> chunkMaxSpeeds; // Fastest speed along each axis of each integration chunk
+    std::vector<int> chunkWallBounces; // Velocity components each integration chunk reversed at a wall
 };
-
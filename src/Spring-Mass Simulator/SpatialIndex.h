@@ -0,0 +1,50 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <vector>
+
+//Spheres sorted along each axis by the sweep and prune broad phase, kept after the step for queries by region.
+//For every axis it holds the begin point (center - radius) of each sphere in ascending order, with the sphere's index
+//in the SphereStore. The points are those the broad phase sorted, before the step moved the spheres; slack bounds how
+//far along each axis a sphere went since, so queries stay conservative for the current and interpolated centers.
+
+struct SpatialIndexAxis {
+    std::vector<float> begin; // Sorted
+    std::vector<int> index;   // Sphere of each begin point
+};
+
+struct SpatialIndex
+{
+    SpatialIndexAxis axes[3];
+    float maxDiameter = 0.0f;                  // A sphere beginning further than this before a point can't reach it
+    glm::vec3 slack = glm::vec3(0.0f);         // Largest distance moved along each axis since the points were taken
+    bool valid = false;                        // False when the broad phase doesn't sort, e.g. with brute force
+
+    int size() const { return static_cast<int>(axes[0].begin.size()); }
+
+    // Entries [first, last) of an axis whose sphere may overlap [low, high] along it
+    void range(int axis, float low, float high, int& first, int& last) const {
+        const std::vector<float>& begin = axes[axis].begin;
+        float pad = slack[axis];
+        first = static_cast<int>(std::lower_bound(begin.begin(), begin.end(), low - maxDiameter - pad) - begin.begin());
+        last = static_cast<int>(std::upper_bound(begin.begin(), begin.end(), high + pad) - begin.begin());
+        if (last < first)
+            last = first;
+    }
+
+    // Axis along which the box [low, high] holds the fewest entries, with their range
+    int query(const glm::vec3& low, const glm::vec3& high, int& first, int& last) const {
+        int bestAxis = 0;
+        range(0, low.x, high.x, first, last);
+        for (int axis = 1; axis < 3; axis++) {
+            int axisFirst, axisLast;
+            range(axis, low[axis], high[axis], axisFirst, axisLast);
+            if (axisLast - axisFirst < last - first) {
+                bestAxis = axis;
+                first = axisFirst;
+                last = axisLast;
+            }
+        }
+        return bestAxis;
+    }
+};
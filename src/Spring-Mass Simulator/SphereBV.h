@@ -1,64 +1,69 @@
 #pragma once
 #include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp> // Required for glm::translate and glm::scale
-#include "SphereMesh.h"
+#include "SphereStore.h"
 #include <cmath>
 #include <vector>
 
 
 //This class represents a bounding volume in the shape of a sphere.
-//In default, the sphere is centered at the origin, but then it can be transformed to any position in the world using a transformation matrix.
+//The sphere data itself lives in a SphereStore (structure of arrays), SphereBV is a lightweight view on one entry of it.
 //In default, the sphere has no accerleration, but it can be given a velocity vector to move in the world.
 //We now just ignore rigid body physics that containing rotation and angular velocity.
 
 class SphereBV
 {
 public:
-    glm::vec3 center; // Center of the sphere
-    float radius;     // Radius of the sphere
-    SphereMesh* mesh; // Mesh representation of the sphere
-    glm::mat4 transform; // Transformation matrix for the sphere, decide where to place the sphere in the cubic world
-    glm::vec3 velocity; // Velocity of the sphere
-    float mass;       // Mass of the sphere
-    int complexityLevel; // Complexity level of the sphere, use to generate the sphere mesh by lathing and longhitude
+    // Default constructor, an invalid view
+    SphereBV() : store(nullptr), index(-1) {}
 
-    glm::vec3 color;  // Color of the sphere
+    // Constructor, view on the sphere at the given index of the store
+    SphereBV(SphereStore* store, int index) : store(store), index(index) {}
 
-    int id;
+    // Index of the sphere in its store
+    int getIndex() const { return index; }
 
-    // Default constructor
-    SphereBV() : center(0.0f), radius(0.0f), velocity(0.0f), mass(0.0f), complexityLevel(0), color(0.0f), id(-1), mesh(nullptr) {}
-    
-    // Constructor
-    SphereBV(const glm::vec3& center, float radius, const glm::vec3& velocity, float mass, int complexityLevel, const glm::vec3& color, int id)
-        : center(center), radius(radius), velocity(velocity), mass(mass), color(color), id(id), mesh(nullptr) {
-        // Ensure minimum complexity of 1 to avoid empty mesh data.
-        int effectiveComplexity = (complexityLevel < 8 ? 8 : complexityLevel);
-        this->complexityLevel = effectiveComplexity;
-        mesh = new SphereMesh(effectiveComplexity, color); // Create a new sphere mesh with the given complexity level
-        transform = glm::mat4(1.0f); // Initialize the transformation matrix to identity
-        transform = glm::translate(transform, center); // Translate the sphere to its center position
-        transform = glm::scale(transform, glm::vec3(radius)); // Scale the sphere to its radius
+    int id() const { return store->id[index]; }
+
+    glm::vec3 center() const {
+        return glm::vec3(store->centerX[index], store->centerY[index], store->centerZ[index]);
     }
-    
-    // Destructor
-    ~SphereBV() {
-        // We don't delete mesh here as ownership is managed elsewhere
+    void setCenter(const glm::vec3& center) {
+        store->centerX[index] = center.x;
+        store->centerY[index] = center.y;
+        store->centerZ[index] = center.z;
     }
 
+    float radius() const { return store->radius[index]; }
+
+    glm::vec3 velocity() const {
+        return glm::vec3(store->velocityX[index], store->velocityY[index], store->velocityZ[index]);
+    }
+    void setVelocity(const glm::vec3& velocity) {
+        store->velocityX[index] = velocity.x;
+        store->velocityY[index] = velocity.y;
+        store->velocityZ[index] = velocity.z;
+    }
+
+    float mass() const { return 1.0f / store->inverseMass[index]; }
+    float inverseMass() const { return store->inverseMass[index]; }
+
     // Check if a point is inside the sphere
     bool contains(const glm::vec3& point) const {
-        return glm::length(point - center) <= radius;
+        return glm::length(point - center()) <= radius();
     }
 
     // Check if another sphere intersects with this one
     bool intersects(const SphereBV& other) const {
-        float distance = glm::length(other.center - center);
-        return distance <= (radius + other.radius);
+        float distance = glm::length(other.center() - center());
+        return distance <= (radius() + other.radius());
     }
+
+private:
+    SphereStore* store;
+    int index;
 };
 
 
 inline bool operator==(const SphereBV &lhs, const SphereBV &rhs) {
-    return lhs.id == rhs.id;
-}
\ No newline at end of file
+    return lhs.id() == rhs.id();
+}
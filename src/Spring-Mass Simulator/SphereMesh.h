@@ -1,5 +1,6 @@
 #pragma once
 #include <glm/glm.hpp>
+#include "ResourceGeneration.h"
 
 #include <vector>
 #include <cmath>
@@ -14,31 +15,48 @@ struct vertice {
     glm::vec3 color;
 };
 
+//A unit sphere at the origin, the same for every sphere of a complexity level.
+//Position, radius and color are per-instance data, so one mesh is shared through SphereMeshCache.
 class SphereMesh {
     public:
-        SphereMesh(int complexityLevel, glm::vec3 color) {
+        explicit SphereMesh(int complexityLevel) {
             // Generate the sphere mesh based on the complexity level
             this->complexityLevel = complexityLevel;
-            this->color = color;
+            this->generation = nextResourceGeneration();
             generateMesh();
         }
 
         //Getter methods to access the mesh data
-        const std::vector<vertice>& getVertices() const {
+        const std::vector<glm::vec3>& getVertices() const {
             return vertices;
         }
         const std::vector<int>& getIndices() const {
             return indices;
         }
+        int getComplexityLevel() const {
+            return complexityLevel;
+        }
+        // Stamp of this mesh, a level built again after being freed gets a new one
+        uint64_t getGeneration() const {
+            return generation;
+        }
+
+        // Bytes of vertex and index data
+        size_t memoryBytes() const {
+            return vertices.size() * sizeof(glm::vec3) + indices.size() * sizeof(int);
+        }
 
     private:
     int complexityLevel; // Complexity level of the sphere mesh
-    glm::vec3 color;
+    uint64_t generation; // See ResourceGeneration.h
 
-    std::vector<vertice> vertices; 
+    std::vector<glm::vec3> vertices; 
     std::vector<int> indices;
 
     void generateMesh() {
+        vertices.reserve(complexityLevel * complexityLevel);
+        indices.reserve(complexityLevel * (complexityLevel - 1) * 6);
+
         // Generate the mesh vertices data for the sphere by lathing and longitude
         for(int i = 0; i < complexityLevel; i++){
             for(int j = 0; j < complexityLevel; j++){
@@ -47,11 +65,7 @@ class SphereMesh {
                 float y = cos(theta); 
                 float x = sin(theta) * cos(phi);
                 float z = sin(theta) * sin(phi);
-                // Changed: create a vertice with position and color
-                vertice v;
-                v.pos = glm::vec3(x, y, z);
-                v.color = color;
-                vertices.push_back(v); // Add vertex to the mesh
+                vertices.push_back(glm::vec3(x, y, z)); // Add vertex to the mesh
             }
         }
 
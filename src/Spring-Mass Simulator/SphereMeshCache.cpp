@@ -0,0 +1,56 @@
+#include "SphereMeshCache.h"
+
+SphereMeshCache& SphereMeshCache::get() {
+    static SphereMeshCache cache;
+    return cache;
+}
+
+std::shared_ptr<const SphereMesh> SphereMeshCache::acquire(int complexityLevel) {
+    std::promise<std::shared_ptr<const SphereMesh>> promise;
+    Entry* entry;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        entry = &meshes[complexityLevel];
+        if (std::shared_ptr<const SphereMesh> mesh = entry->mesh.lock())
+            return mesh;
+        if (entry->building.valid()) {
+            // Another thread builds this level, wait for it without holding the lock
+            std::shared_future<std::shared_ptr<const SphereMesh>> building = entry->building;
+            lock.unlock();
+            return building.get();
+        }
+        entry->building = promise.get_future().share();
+    }
+
+    // This thread builds the level, the other levels stay available meanwhile
+    std::shared_ptr<const SphereMesh> mesh;
+    try {
+        mesh = std::make_shared<const SphereMesh>(complexityLevel);
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            entry->building = std::shared_future<std::shared_ptr<const SphereMesh>>();
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entry->mesh = mesh;
+        entry->building = std::shared_future<std::shared_ptr<const SphereMesh>>(); // The cache keeps only a weak reference
+    }
+    promise.set_value(mesh);
+    return mesh;
+}
+
+SphereMeshCache::Usage SphereMeshCache::usage() {
+    std::lock_guard<std::mutex> lock(mutex);
+    Usage usage;
+    for (const auto& entry : meshes) {
+        if (std::shared_ptr<const SphereMesh> mesh = entry.second.mesh.lock()) {
+            usage.meshCount++;
+            usage.memoryBytes += mesh->memoryBytes();
+        }
+    }
+    return usage;
+}
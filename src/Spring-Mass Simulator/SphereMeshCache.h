@@ -0,0 +1,41 @@
+#pragma once
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "SphereMesh.h"
+
+//One shared unit-sphere mesh per complexity level.
+//Every sphere of a level holds a reference to the same mesh, so the mesh memory grows with the number of levels in
+//use instead of the number of spheres. The cache itself only keeps weak references: a mesh is freed as soon as the
+//last render table using it is cleared or destroyed, and built again the next time a sphere asks for that level.
+//acquire() can be called from several threads at once, e.g. by the workers building a world. A mesh is built outside
+//the cache lock: the first thread asking for a level builds it, only the threads asking for that same level wait.
+
+class SphereMeshCache
+{
+public:
+    struct Usage {
+        int meshCount = 0;      // Meshes currently alive
+        size_t memoryBytes = 0; // Their total size
+    };
+
+    // The cache shared by every world
+    static SphereMeshCache& get();
+
+    // The mesh of the given complexity level, built on first use
+    std::shared_ptr<const SphereMesh> acquire(int complexityLevel);
+
+    // Meshes currently alive and their total size, read under one lock
+    Usage usage();
+    size_t memoryBytes() { return usage().memoryBytes; }
+
+private:
+    struct Entry {
+        std::weak_ptr<const SphereMesh> mesh;
+        std::shared_future<std::shared_ptr<const SphereMesh>> building; // Valid while a thread builds the mesh
+    };
+
+    std::mutex mutex;
+    std::map<int, Entry> meshes; // Entries are never erased, so a reference stays valid outside the lock
+};
@@ -0,0 +1,81 @@
+#pragma once
+#include <glm/glm.hpp>
+#include "SphereMesh.h"
+#include "SphereMeshCache.h"
+#include <memory>
+#include <vector>
+
+//Per-instance data used to draw one sphere: the unit sphere mesh is scaled by radius and moved to center.
+//It is derived from the physics data only when a frame is rendered, instead of a full mat4 per sphere per step.
+struct SphereInstance {
+    glm::vec3 center;
+    float radius;
+};
+static_assert(sizeof(SphereInstance) == 16, "SphereInstance should stay 16 bytes");
+
+//Render-only state of a sphere. None of it is touched by the physics, so it lives in its own table
+//instead of next to the center/velocity data in the SphereStore.
+struct SphereRenderData {
+    std::shared_ptr<const SphereMesh> mesh; // Unit sphere of the sphere's complexity level, shared with every sphere of that level
+    glm::vec3 color;     // Color of the sphere, drawn as a per-instance attribute of the shared mesh
+    int complexityLevel; // Complexity level of the sphere, use to generate the sphere mesh by lathing and longhitude
+};
+
+//This class holds the render data of every sphere, indexed by sphere id.
+//It lives on the render side (see WorldRenderData.h), a headless simulation never has one.
+class SphereRenderTable
+{
+public:
+    std::vector<SphereRenderData> entries;
+
+    // Visible spheres of the current frame, rebuilt by WorldRenderData::buildRenderInstances
+    std::vector<SphereInstance> instances;
+    std::vector<int> instanceIds; // Sphere id of each instance
+
+    int size() const {
+        return static_cast<int>(entries.size());
+    }
+
+    void reserve(int numSpheres) {
+        entries.reserve(numSpheres);
+    }
+
+    // Make room for the given number of spheres up front, so addSphere can then run on several threads
+    void resize(int numSpheres) {
+        entries.resize(numSpheres, SphereRenderData{ nullptr, glm::vec3(0.0f), 0 });
+    }
+
+    // Remove all entries, a mesh is freed once no table uses it anymore
+    void clear() {
+        entries.clear();
+        instances.clear();
+        instanceIds.clear();
+    }
+
+    // Create the render data of the sphere with the given id
+    // Only resizes the table when the id is past its end, otherwise different ids can be added concurrently
+    void addSphere(int id, int complexity, const glm::vec3& color) {
+        if (id >= size()) {
+            entries.resize(id + 1, SphereRenderData{ nullptr, glm::vec3(0.0f), 0 });
+        }
+
+        // Ensure minimum complexity of 8 to avoid empty mesh data.
+        int effectiveComplexity = (complexity < 8 ? 8 : complexity);
+        SphereRenderData& entry = entries[id];
+        entry.complexityLevel = effectiveComplexity;
+        entry.color = color;
+        entry.mesh = SphereMeshCache::get().acquire(effectiveComplexity); // Shared sphere mesh of the given complexity level
+    }
+
+    SphereRenderData& operator[](int id) {
+        return entries[id];
+    }
+    const SphereRenderData& operator[](int id) const {
+        return entries[id];
+    }
+
+    // Bytes of render data per sphere, the shared meshes come on top once per complexity level
+    static size_t bytesPerSphere() {
+        return sizeof(SphereRenderData);
+    }
+};
@@ -0,0 +1,160 @@
+#include "SphereRenderer.h"
+#include <cmath>
+#include <cstddef>
+#include "SphereMeshCache.h"
+
+namespace {
+    const char* sphereVertexShaderSource = R"(
+        #version 330 core
+        layout(location = 0) in vec3 aPos;
+        layout(location = 1) in vec4 aInstance; // xyz = center, w = radius
+        layout(location = 2) in vec3 aColor;
+        out vec3 ourColor;
+        uniform mat4 view;
+        uniform mat4 projection;
+        void main() {
+            gl_Position = projection * view * vec4(aPos * aInstance.w + aInstance.xyz, 1.0);
+            ourColor = aColor;
+        }
+    )";
+
+    const char* sphereFragmentShaderSource = R"(
+        #version 330 core
+        out vec4 FragColor;
+        in vec3 ourColor;
+        void main() {
+            FragColor = vec4(ourColor, 1.0f);
+        }
+    )";
+}
+
+constexpr int SphereRenderer::lodLevels[SphereRenderer::lodLevelCount];
+
+SphereRenderer::SphereRenderer(GpuResourceManager& resources)
+: resources(resources),
+program(resources.createProgram(sphereVertexShaderSource, sphereFragmentShaderSource)),
+instanceBufferCapacity(0),
+lodGeneration(0),
+cameraPosition(0.0f),
+pixelsPerUnit(1.0f),
+lastDrawCalls(0),
+lastInstanceCount(0),
+lastTriangleCount(0) {
+    glGenBuffers(1, &instanceBuffer);
+}
+
+SphereRenderer::~SphereRenderer() {
+    glDeleteBuffers(1, &instanceBuffer);
+}
+
+void SphereRenderer::begin(const glm::vec3& cameraPosition, float fovRadians, int viewportHeight, uint64_t worldGeneration) {
+    // A new or reset world reuses the sphere ids for other spheres, their levels start over
+    if (worldGeneration != lodGeneration) {
+        lodIndex.clear();
+        lodGeneration = worldGeneration;
+    }
+    this->cameraPosition = cameraPosition;
+    pixelsPerUnit = 0.5f * viewportHeight / std::tan(0.5f * fovRadians);
+    for (auto& entry : levels) {
+        entry.second.mesh = nullptr;
+        entry.second.instances.clear(); // Keeps the capacity, a steady scene queues without allocating
+    }
+}
+
+void SphereRenderer::add(int id, const SphereInstance& instance, const SphereRenderData& sphere) {
+    // Complexity that gives segments of about lodPixelsPerSegment along the sphere's outline on screen
+    float distance = glm::length(instance.center - cameraPosition);
+    float complexity = static_cast<float>(sphere.complexityLevel);
+    if (distance > instance.radius) {
+        float screenRadius = instance.radius * pixelsPerUnit / distance;
+        complexity = 2.0f * static_cast<float>(M_PI) * screenRadius / lodPixelsPerSegment;
+    }
+
+    // The sphere's own mesh once a level would be as fine as it
+    int lod = selectLod(id, complexity);
+    const std::shared_ptr<const SphereMesh>* mesh = &sphere.mesh;
+    int complexityLevel = sphere.complexityLevel;
+    if (lodLevels[lod] < sphere.complexityLevel) {
+        if (!lodMeshes[lod])
+            lodMeshes[lod] = SphereMeshCache::get().acquire(lodLevels[lod]);
+        mesh = &lodMeshes[lod];
+        complexityLevel = lodLevels[lod];
+    }
+
+    Level& level = levels[complexityLevel];
+    if (!level.mesh) {
+        if (!*mesh || (*mesh)->getIndices().empty())
+            return; // Skip rendering if mesh data is missing
+        level.mesh = &resources.sphereMesh(*mesh);
+    }
+    level.instances.push_back({ instance.center, instance.radius, sphere.color });
+}
+
+// Level of detail of sphere id for the given complexity, moves to a coarser level only past the hysteresis margin
+int SphereRenderer::selectLod(int id, float complexity) {
+    if (id >= static_cast<int>(lodIndex.size()))
+        lodIndex.resize(id + 1, 0);
+
+    // Coarsest level fine enough, and coarsest level that also leaves the hysteresis margin
+    int finer = 0;
+    while (finer < lodLevelCount - 1 && lodLevels[finer] < complexity)
+        finer++;
+    int coarser = finer;
+    while (coarser < lodLevelCount - 1 && lodLevels[coarser] * lodHysteresis < complexity)
+        coarser++;
+
+    int lod = lodIndex[id];
+    if (lod < finer)
+        lod = finer;
+    else if (lod > coarser)
+        lod = coarser;
+    lodIndex[id] = static_cast<uint8_t>(lod);
+    return lod;
+}
+
+void SphereRenderer::draw() {
+    // Pack the instances of every level back to back, so they are streamed in one upload
+    upload.clear();
+    for (const auto& entry : levels)
+        upload.insert(upload.end(), entry.second.instances.begin(), entry.second.instances.end());
+
+    lastDrawCalls = 0;
+    lastInstanceCount = static_cast<int>(upload.size());
+    lastTriangleCount = 0;
+    if (upload.empty())
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    if (upload.size() > instanceBufferCapacity)
+        instanceBufferCapacity = upload.size() * 2;
+    // Orphan last frame's storage, so the driver doesn't wait for the draws still reading it
+    glBufferData(GL_ARRAY_BUFFER, instanceBufferCapacity * sizeof(SphereDrawInstance), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, upload.size() * sizeof(SphereDrawInstance), upload.data());
+
+    resources.useProgram(program);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    size_t first = 0;
+    for (auto& entry : levels) {
+        Level& level = entry.second;
+        if (level.instances.empty())
+            continue;
+
+        size_t offset = first * sizeof(SphereDrawInstance);
+        glBindVertexArray(level.mesh->vao);
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+        glEnableVertexAttribArray(2);
+        glVertexAttribDivisor(2, 1);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(SphereDrawInstance), (void*)(offset + offsetof(SphereDrawInstance, center)));
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(SphereDrawInstance), (void*)(offset + offsetof(SphereDrawInstance, color)));
+        glDrawElementsInstanced(GL_TRIANGLES, level.mesh->indexCount, GL_UNSIGNED_INT, 0, static_cast<GLsizei>(level.instances.size()));
+        lastDrawCalls++;
+        lastTriangleCount += static_cast<long long>(level.mesh->indexCount / 3) * static_cast<long long>(level.instances.size());
+        first += level.instances.size();
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUseProgram(0);
+}
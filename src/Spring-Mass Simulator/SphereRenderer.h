@@ -0,0 +1,81 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+#include "SphereRenderTable.h"
+#include "GpuResourceManager.h"
+
+//What the GPU reads per sphere: the shared mesh of its level is scaled by radius, moved to center and drawn in color.
+struct SphereDrawInstance {
+    glm::vec3 center;
+    float radius;
+    glm::vec3 color;
+};
+static_assert(sizeof(SphereDrawInstance) == 28, "SphereDrawInstance should stay tightly packed");
+
+//Draws the spheres with one instanced draw call per complexity level.
+//The static buffers of each level's unit mesh come from GpuResourceManager. Every frame the visible spheres are
+//queued by level with add(), then draw() streams the instance data of all of them in a single upload and issues
+//one glDrawElementsInstanced per level.
+//Each sphere is drawn at a level of detail picked from its radius on screen among a small set of shared levels, and
+//never finer than its own mesh. A sphere only goes back to a coarser level once that level is comfortably enough
+//for it, so a sphere at the edge between two levels doesn't switch back and forth every frame.
+//Needs a current OpenGL context for its whole lifetime, destructor included.
+
+class SphereRenderer
+{
+public:
+    explicit SphereRenderer(GpuResourceManager& resources);
+    ~SphereRenderer();
+
+    SphereRenderer(const SphereRenderer&) = delete;
+    SphereRenderer& operator=(const SphereRenderer&) = delete;
+
+    // Start a new frame seen from cameraPosition, drops the instances queued for the previous one
+    // fovRadians is the vertical field of view and viewportHeight the height of the viewport in pixels
+    // worldGeneration stamps the world drawn (its boundaryGeneration): another one forgets the levels of the sphere ids
+    void begin(const glm::vec3& cameraPosition, float fovRadians, int viewportHeight, uint64_t worldGeneration);
+
+    // Queue sphere id for this frame
+    void add(int id, const SphereInstance& instance, const SphereRenderData& sphere);
+
+    // Upload the queued instances and draw them with the camera of the resource manager's frame
+    void draw();
+
+    // Stats of the last draw()
+    int drawCalls() const { return lastDrawCalls; }
+    int instanceCount() const { return lastInstanceCount; }
+    long long triangleCount() const { return lastTriangleCount; }
+
+private:
+    // Instances queued for one complexity level this frame
+    struct Level {
+        const GpuMesh* mesh = nullptr; // Looked up on the first instance of the frame
+        std::vector<SphereDrawInstance> instances;
+    };
+
+    static constexpr int lodLevelCount = 6;
+    static constexpr int lodLevels[lodLevelCount] = { 8, 16, 32, 64, 128, 256 }; // Complexity of each level of detail
+    static constexpr float lodPixelsPerSegment = 6.0f; // Screen size of a mesh segment the levels aim for
+    static constexpr float lodHysteresis = 0.75f;      // Share of a coarser level a sphere must fit in to go back to it
+
+    GpuResourceManager& resources;
+    GpuProgram& program;
+    GLuint instanceBuffer;             // Shared by every level, each draws from its own range
+    size_t instanceBufferCapacity;     // In instances
+    std::vector<SphereDrawInstance> upload; // Instances of every level back to back, reused across frames
+    std::map<int, Level> levels;       // By complexity level
+    std::shared_ptr<const SphereMesh> lodMeshes[lodLevelCount]; // Acquired on first use
+    std::vector<uint8_t> lodIndex; // Current level of detail of each sphere id
+    uint64_t lodGeneration;        // World the sphere ids of lodIndex belong to
+    glm::vec3 cameraPosition;
+    float pixelsPerUnit;           // Screen radius in pixels of a unit radius at unit distance
+    int lastDrawCalls;
+    int lastInstanceCount;
+    long long lastTriangleCount;
+
+    int selectLod(int id, float complexity);
+};
@@ -0,0 +1,106 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+//This class stores every sphere of the simulation as a structure of arrays.
+//The physics loops (broad phase, integration, boundary handling) only touch the hot arrays below,
+//so each of them streams through contiguous floats instead of whole SphereBV objects.
+//Render-only data (mesh, color, transform) is not stored here at all, see SphereRenderTable.
+
+class SphereStore
+{
+public:
+    // Hot physics data, one entry per sphere
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> radius;
+    std::vector<float> velocityX;
+    std::vector<float> velocityY;
+    std::vector<float> velocityZ;
+    std::vector<float> inverseMass; // 1 / mass, the collision response only ever needs the inverse
+    std::vector<int> id;
+
+    int size() const {
+        return static_cast<int>(id.size());
+    }
+
+    void reserve(int numSpheres) {
+        centerX.reserve(numSpheres);
+        centerY.reserve(numSpheres);
+        centerZ.reserve(numSpheres);
+        radius.reserve(numSpheres);
+        velocityX.reserve(numSpheres);
+        velocityY.reserve(numSpheres);
+        velocityZ.reserve(numSpheres);
+        inverseMass.reserve(numSpheres);
+        id.reserve(numSpheres);
+    }
+
+    // Set the number of spheres, new ones are filled in with setSphere
+    void resize(int numSpheres) {
+        centerX.resize(numSpheres);
+        centerY.resize(numSpheres);
+        centerZ.resize(numSpheres);
+        radius.resize(numSpheres);
+        velocityX.resize(numSpheres);
+        velocityY.resize(numSpheres);
+        velocityZ.resize(numSpheres);
+        inverseMass.resize(numSpheres);
+        id.resize(numSpheres);
+    }
+
+    // Remove all spheres
+    void clear() {
+        centerX.clear();
+        centerY.clear();
+        centerZ.clear();
+        radius.clear();
+        velocityX.clear();
+        velocityY.clear();
+        velocityZ.clear();
+        inverseMass.clear();
+        id.clear();
+    }
+
+    // Append a sphere and return its index in the store
+    int addSphere(const glm::vec3& center, float sphereRadius, const glm::vec3& velocity, float mass, int sphereId) {
+        centerX.push_back(center.x);
+        centerY.push_back(center.y);
+        centerZ.push_back(center.z);
+        radius.push_back(sphereRadius);
+        velocityX.push_back(velocity.x);
+        velocityY.push_back(velocity.y);
+        velocityZ.push_back(velocity.z);
+        inverseMass.push_back(1.0f / mass);
+        id.push_back(sphereId);
+        return size() - 1;
+    }
+
+    // Overwrite the sphere at the given index, different indices can be set from different threads
+    void setSphere(int index, const glm::vec3& center, float sphereRadius, const glm::vec3& velocity, float mass, int sphereId) {
+        centerX[index] = center.x;
+        centerY[index] = center.y;
+        centerZ[index] = center.z;
+        radius[index] = sphereRadius;
+        velocityX[index] = velocity.x;
+        velocityY[index] = velocity.y;
+        velocityZ[index] = velocity.z;
+        inverseMass[index] = 1.0f / mass;
+        id[index] = sphereId;
+    }
+
+    // Add deltaVelocity to the velocity of the spheres [begin, end), e.g. gravity * deltaTime
+    void accelerate(int begin, int end, const glm::vec3& deltaVelocity) {
+        for (int i = begin; i < end; i++) {
+            velocityX[i] += deltaVelocity.x;
+            velocityY[i] += deltaVelocity.y;
+            velocityZ[i] += deltaVelocity.z;
+        }
+    }
+
+    // Bytes of physics data per sphere
+    static size_t bytesPerSphere() {
+        return 8 * sizeof(float) + sizeof(int);
+    }
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+//A bounded queue for exactly one producer thread and one consumer thread, without locks.
+//The producer only writes tail and the consumer only writes head, so each side just needs an acquire load of the
+//other side's index to see the items it published. Capacity must be a power of two.
+
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    // Producer side, returns false if the queue is full
+    bool push(const T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity)
+            return false;
+        items[t & (Capacity - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, returns false if the queue is empty
+    bool pop(T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        item = items[h & (Capacity - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // The indices only grow, the slot is index % Capacity. Each one gets its own cache line.
+    alignas(64) std::atomic<size_t> head{0}; // Next item to pop
+    alignas(64) std::atomic<size_t> tail{0}; // Next free slot
+    alignas(64) T items[Capacity];
+};
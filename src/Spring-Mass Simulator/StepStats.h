@@ -0,0 +1,119 @@
+#pragma once
+#include <chrono>
+
+//Timings and counters of the simulation steps.
+//SimulatorWorld::stepSimulation times each phase of a step with a scoped timer and counts what the phases did,
+//then adds the step to a StepStatsWindow that averages the last steps for the UI, the benchmark and the CLI.
+//Build with CDE_ENABLE_STATS=0 to compile the instrumentation out: the timers and counters disappear from the
+//step, the window stays empty.
+
+#ifndef CDE_ENABLE_STATS
+#define CDE_ENABLE_STATS 1
+#endif
+
+#if CDE_ENABLE_STATS
+// The statement only exists in builds with the instrumentation
+#define CDE_STATS(...) __VA_ARGS__
+#define CDE_STATS_CONCAT_INNER(a, b) a##b
+#define CDE_STATS_CONCAT(a, b) CDE_STATS_CONCAT_INNER(a, b)
+// Add the time until the end of the enclosing scope to nanoseconds
+#define CDE_STATS_SCOPE(nanoseconds) ScopedPhaseTimer CDE_STATS_CONCAT(phaseTimer, __LINE__)(nanoseconds)
+#else
+#define CDE_STATS(...)
+#define CDE_STATS_SCOPE(nanoseconds)
+#endif
+
+// One step, or the average of several (the counters of an average are not whole numbers)
+// The times are whole nanoseconds of the steady clock, an average rounds them down
+// The world boundary is handled by the integration kernel, its time is part of integrationNs
+struct StepStats {
+    long long broadNs;
+    long long narrowNs;
+    long long responseNs;
+    long long integrationNs;
+    double candidatePairs; // Pairs found by the broad phase
+    double confirmedPairs; // Pairs left after the narrow phase, the colliding ones
+    double gjkIterations;  // Over every pair of the narrow phase
+    double wallBounces;    // Velocity components reversed at a wall
+
+    long long totalNs() const { return broadNs + narrowNs + responseNs + integrationNs; }
+
+    static double toMs(long long nanoseconds) { return nanoseconds / 1000000.0; }
+};
+
+class ScopedPhaseTimer
+{
+public:
+    explicit ScopedPhaseTimer(long long& nanoseconds) : nanoseconds(nanoseconds), start(std::chrono::steady_clock::now()) {}
+    ~ScopedPhaseTimer() {
+        nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    ScopedPhaseTimer(const ScopedPhaseTimer&) = delete;
+    ScopedPhaseTimer& operator=(const ScopedPhaseTimer&) = delete;
+
+private:
+    long long& nanoseconds;
+    std::chrono::steady_clock::time_point start;
+};
+
+// The last steps, in a ring, with their average
+class StepStatsWindow
+{
+public:
+    static constexpr int capacity = 64; // Steps averaged
+
+    StepStatsWindow() : next(0), filled(0) {}
+
+    void add(const StepStats& step) {
+        steps[next] = step;
+        next = (next + 1) % capacity;
+        if (filled < capacity)
+            filled++;
+    }
+
+    void clear() {
+        next = 0;
+        filled = 0;
+    }
+
+    // Steps in the window, at most capacity
+    int count() const { return filled; }
+
+    // The most recent step, all zero when there is none
+    StepStats last() const {
+        return filled > 0 ? steps[(next + capacity - 1) % capacity] : StepStats();
+    }
+
+    // Average of the steps in the window, all zero when there is none
+    StepStats average() const {
+        StepStats sum = {};
+        for (int i = 0; i < filled; i++) {
+            sum.broadNs += steps[i].broadNs;
+            sum.narrowNs += steps[i].narrowNs;
+            sum.responseNs += steps[i].responseNs;
+            sum.integrationNs += steps[i].integrationNs;
+            sum.candidatePairs += steps[i].candidatePairs;
+            sum.confirmedPairs += steps[i].confirmedPairs;
+            sum.gjkIterations += steps[i].gjkIterations;
+            sum.wallBounces += steps[i].wallBounces;
+        }
+        if (filled == 0)
+            return sum;
+        sum.broadNs /= filled;
+        sum.narrowNs /= filled;
+        sum.responseNs /= filled;
+        sum.integrationNs /= filled;
+        double scale = 1.0 / filled;
+                                        sum.candidatePairs *= scale;
+        sum.confirmedPairs *= scale;
+        sum.gjkIterations *= scale;
+        sum.wallBounces *= scale;
+        return sum;
+    }
+
+private:
+    StepStats steps[capacity];
+    int next;   // Slot of the next step
+    int filled;
+};
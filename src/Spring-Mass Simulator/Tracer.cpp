@@ -0,0 +1,198 @@
+#include "Tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+constexpr int Tracer::eventsPerThread;
+std::atomic<bool> Tracer::recording(false);
+
+namespace {
+
+const int threadNameSize = 32;
+
+struct TraceEvent {
+    const char* name;
+    int64_t nanoseconds;
+    char phase; // 'B' or 'E'
+};
+
+// Events of one thread, written by that thread only
+struct ThreadBuffer {
+    TraceEvent events[Tracer::eventsPerThread];
+    std::atomic<uint64_t> written{0}; // Events ever written, the newest eventsPerThread of them are kept
+    int threadId = 0;
+    char threadName[threadNameSize] = {};
+    bool inUse = false; // Owned by a running thread, guarded by buffersMutex
+};
+
+std::mutex buffersMutex; // Guards the buffer list and the names and owners of the buffers
+std::vector<std::unique_ptr<ThreadBuffer>>& threadBuffers() {
+    static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    return buffers;
+}
+int nextThreadId = 1;
+std::atomic<int64_t> clearedAt(0); // Events older than this were dropped by clear
+
+// Buffer of the calling thread, given back for reuse when the thread exits
+struct ThreadSlot {
+    ThreadBuffer* buffer = nullptr;
+    char name[threadNameSize] = {};
+
+    ~ThreadSlot() {
+        if (!buffer)
+            return;
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        buffer->inUse = false;
+    }
+};
+thread_local ThreadSlot threadSlot;
+
+int64_t nowNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Only a thread that records gets a buffer, the first event of a thread takes the lock once
+ThreadBuffer* acquireBuffer() {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    std::vector<std::unique_ptr<ThreadBuffer>>& buffers = threadBuffers();
+    ThreadBuffer* buffer = nullptr;
+    for (auto& candidate : buffers) {
+        if (!candidate->inUse) {
+            buffer = candidate.get();
+            break;
+        }
+    }
+    if (!buffer) {
+        buffers.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+        buffer = buffers.back().get();
+    }
+
+    // The events of the thread that owned the buffer before are dropped, they would show under the new thread
+    buffer->written.store(0, std::memory_order_relaxed);
+    buffer->threadId = nextThreadId++;
+    buffer->inUse = true;
+    std::memcpy(buffer->threadName, threadSlot.name, threadNameSize);
+    threadSlot.buffer = buffer;
+    return buffer;
+}
+
+void writeJsonString(std::ofstream& outputFile, const char* text) {
+    outputFile << '"';
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\')
+            outputFile << '\\';
+        outputFile << *c;
+    }
+    outputFile << '"';
+}
+
+} // namespace
+
+void Tracer::record(const char* name, char phase) {
+    ThreadBuffer* buffer = threadSlot.buffer;
+    if (!buffer)
+        buffer = acquireBuffer();
+
+    // Only this thread writes the buffer: fill the slot, then publish it
+    uint64_t index = buffer->written.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer->events[index % eventsPerThread];
+    event.name = name;
+    event.nanoseconds = nowNanoseconds();
+    event.phase = phase;
+    buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::setThreadName(const char* name) {
+    std::snprintf(threadSlot.name, threadNameSize, "%s", name);
+    if (threadSlot.buffer) {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        std::memcpy(threadSlot.buffer->threadName, threadSlot.name, threadNameSize);
+    }
+}
+
+void Tracer::clear() {
+    clearedAt.store(nowNanoseconds(), std::memory_order_relaxed);
+}
+
+bool Tracer::writeChromeTrace(const char* path) {
+    // Copy the events of every thread first, the file is written without holding the lock
+    struct ThreadEvents {
+        int threadId;
+        char threadName[threadNameSize];
+        std::vector<TraceEvent> events;
+    };
+    std::vector<ThreadEvents> threads;
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        for (const auto& buffer : threadBuffers()) {
+            uint64_t written = buffer->written.load(std::memory_order_acquire);
+            uint64_t first = written > static_cast<uint64_t>(eventsPerThread) ? written - eventsPerThread : 0;
+            ThreadEvents copy;
+            copy.events.reserve(written - first);
+            copy.threadId = buffer->threadId;
+            std::memcpy(copy.threadName, buffer->threadName, threadNameSize);
+            for (uint64_t i = first; i < written; i++)
+                copy.events.push_back(buffer->events[i % eventsPerThread]);
+
+            // The thread kept recording during the copy: the slots it wrote since (and the one it may be writing)
+            // held the oldest events copied, those may be torn
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t writtenAfter = buffer->written.load(std::memory_order_relaxed);
+            if (writtenAfter + 1 > first + eventsPerThread) {
+                uint64_t overwritten = std::min<uint64_t>(writtenAfter + 1 - eventsPerThread - first, copy.events.size());
+                copy.events.erase(copy.events.begin(), copy.events.begin() + overwritten);
+            }
+            threads.push_back(std::move(copy));
+        }
+    }
+
+    std::ofstream outputFile(path);
+    if (!outputFile)
+        return false;
+
+    // Timestamps in microseconds from the oldest event kept
+    int64_t cleared = clearedAt.load(std::memory_order_relaxed);
+    int64_t origin = INT64_MAX;
+    for (const ThreadEvents& thread : threads)
+        for (const TraceEvent& event : thread.events)
+            if (event.nanoseconds >= cleared)
+                origin = std::min(origin, event.nanoseconds);
+
+    outputFile << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n"
+               << "  {\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"Collision simulation\"}}";
+    outputFile << std::fixed << std::setprecision(3);
+    for (const ThreadEvents& thread : threads) {
+        outputFile << ",\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread.threadId << ", \"args\": {\"name\": ";
+        if (thread.threadName[0])
+            writeJsonString(outputFile, thread.threadName);
+        else
+            outputFile << "\"Thread " << thread.threadId << "\"";
+        outputFile << "}}";
+
+        // An end whose begin was overwritten or cleared would close a scope that isn't there
+        int depth = 0;
+        for (const TraceEvent& event : thread.events) {
+            if (event.nanoseconds < cleared)
+                continue;
+            if (event.phase == 'E') {
+                if (depth == 0)
+                    continue;
+                depth--;
+            } else {
+                depth++;
+            }
+            outputFile << ",\n  {\"name\": ";
+            writeJsonString(outputFile, event.name);
+            outputFile << ", \"ph\": \"" << event.phase << "\", \"pid\": 1, \"tid\": " << thread.threadId
+                       << ", \"ts\": " << (event.nanoseconds - origin) / 1000.0 << "}";
+        }
+    }
+    outputFile << "\n]}" << std::endl;
+    return static_cast<bool>(outputFile);
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+//Timeline of the simulation phases and jobs on every thread, written as a Chrome trace (chrome://tracing, Perfetto).
+//Recording is off until setRecording(true). A thread then writes the begin and end events of its scopes to its own
+//ring buffer, without locks or allocations: the newest events of every thread are kept, the oldest overwritten.
+//writeChromeTrace can run while the threads record, it skips the events they overwrite during the copy.
+//Build with CDE_ENABLE_TRACE=0 to compile the scopes out, nothing is recorded and nothing is checked.
+
+#ifndef CDE_ENABLE_TRACE
+#define CDE_ENABLE_TRACE 1
+#endif
+
+#if CDE_ENABLE_TRACE
+#define CDE_TRACE_CONCAT_INNER(a, b) a##b
+#define CDE_TRACE_CONCAT(a, b) CDE_TRACE_CONCAT_INNER(a, b)
+// Record the enclosing scope under name, a string literal
+#define CDE_TRACE_SCOPE(name) TraceScope CDE_TRACE_CONCAT(traceScope, __LINE__)(name)
+// Name of the calling thread in the trace, a string literal
+#define CDE_TRACE_THREAD_NAME(name) Tracer::setThreadName(name)
+#else
+#define CDE_TRACE_SCOPE(name)
+#define CDE_TRACE_THREAD_NAME(name)
+#endif
+
+class Tracer
+{
+public:
+    static constexpr int eventsPerThread = 1 << 16; // Ring buffer size, the older events of a thread are overwritten
+
+    static void setRecording(bool on) { recording.store(on, std::memory_order_relaxed); }
+    static bool isRecording() { return recording.load(std::memory_order_relaxed); }
+
+    // Name shown for the calling thread, the buffer keeps it after the thread exits
+    static void setThreadName(const char* name);
+
+    // Write the events of every thread, false if the file can't be opened
+    static bool writeChromeTrace(const char* path);
+    // Drop the events recorded so far
+    static void clear();
+
+private:
+    friend class TraceScope;
+
+    static std::atomic<bool> recording;
+
+    static void record(const char* name, char phase);
+};
+
+// Begin event now, end event at the end of the scope
+// The end is recorded even if recording stopped in between, so every begin written has its end
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name) : name(Tracer::isRecording() ? name : nullptr) {
+        if (this->name)
+            Tracer::record(name, 'B');
+    }
+    ~TraceScope() {
+        if (name)
+            Tracer::record(name, 'E');
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name; // Null when the begin wasn't recorded
+};
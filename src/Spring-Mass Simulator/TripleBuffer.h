@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+
+//Hands the latest value produced by one thread to one other thread, neither of them ever waits.
+//The writer fills its own slot and swaps it with the middle slot, the reader swaps its own slot with the middle
+//one when a newer value was published there. Each thread only ever touches the slot it currently owns,
+//so a slot can be filled or read without any lock, and the reader always gets the most recent complete value.
+
+template <typename T>
+class TripleBuffer
+{
+public:
+    // Writer side: the slot to fill, owned by the writer until publish()
+    T& writeSlot() {
+        return slots[back];
+    }
+
+    // Writer side: make the filled slot the latest value and take another one to fill next
+    void publish() {
+        back = middle.exchange(back | freshBit, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // Reader side: switch to the latest published value, returns false if nothing new was published
+    bool acquireLatest() {
+        if (!(middle.load(std::memory_order_relaxed) & freshBit))
+            return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    // Reader side: the value taken by the last acquireLatest(), owned by the reader until the next one
+    const T& readSlot() const {
+        return slots[front];
+    }
+
+private:
+    static constexpr int indexMask = 3;
+    static constexpr int freshBit = 4; // Set in middle while the writer published a slot the reader hasn't taken yet
+
+    T slots[3];
+    int back = 0;              // Slot of the writer
+    std::atomic<int> middle{1}; // Slot in between, with freshBit
+    int front = 2;             // Slot of the reader
+};
@@ -0,0 +1,31 @@
+#include "WorldBuilder.h"
+#include "Tracer.h"
+
+WorldBuilder::~WorldBuilder() {
+    if (thread.joinable())
+        thread.join();
+}
+
+bool WorldBuilder::start(const WorldSettings& settings) {
+    if (busy())
+        return false;
+
+    total = settings.numSpheres;
+    built.store(0, std::memory_order_relaxed);
+    finished.store(false, std::memory_order_relaxed);
+    thread = std::thread([this, settings]() {
+        CDE_TRACE_THREAD_NAME("World builder");
+        CDE_TRACE_SCOPE("Build world");
+        world.reset(new SimulatorWorld(settings, &built));
+        finished.store(true, std::memory_order_release);
+    });
+    return true;
+}
+
+std::unique_ptr<SimulatorWorld> WorldBuilder::take() {
+    if (!thread.joinable() || !finished.load(std::memory_order_acquire))
+        return nullptr;
+
+    thread.join();
+    return std::move(world);
+}
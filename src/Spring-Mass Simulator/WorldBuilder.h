@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <thread>
+#include "SimulatorWorld.h"
+
+//Builds a SimulatorWorld in the background, so a large scene doesn't freeze the thread asking for it.
+//The build runs on its own thread, which drives the new world's job system: the spheres are created
+//by all of that world's workers. The caller keeps using its current world meanwhile, polls progress()
+//and swaps in the new world once take() returns it.
+
+class WorldBuilder
+{
+public:
+    WorldBuilder() : total(0), built(0), finished(false) {}
+    ~WorldBuilder(); // Waits for a build in progress, its world is dropped
+
+    WorldBuilder(const WorldBuilder&) = delete;
+    WorldBuilder& operator=(const WorldBuilder&) = delete;
+
+    // Start building, returns false if a build is already running
+    bool start(const WorldSettings& settings);
+
+    // True from start() until the built world is taken
+    bool busy() const { return thread.joinable(); }
+
+    // Share of the spheres created so far, from 0 to 1
+    float progress() const {
+        return total > 0 ? static_cast<float>(built.load(std::memory_order_relaxed)) / total : 1.0f;
+    }
+
+    // The finished world, null while the build is still running or when nothing was built
+    std::unique_ptr<SimulatorWorld> take();
+
+private:
+    std::thread thread;
+    std::unique_ptr<SimulatorWorld> world; // Written by the build thread, read once finished is set
+    int total;
+    std::atomic<int> built;
+    std::atomic<bool> finished;
+};
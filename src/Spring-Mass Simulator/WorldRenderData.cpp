@@ -0,0 +1,150 @@
+#include "WorldRenderData.h"
+#include <algorithm>
+#include "CounterRng.h"
+#include "Frustum.h"
+#include "ResourceGeneration.h"
+#include "Scenario.h"
+#include "Tracer.h"
+
+constexpr int WorldRenderData::instanceGrainSize;
+
+void WorldRenderData::update(const SimulatorWorld& world, int minComplexity, int maxComplexity) {
+    if (world.generation == worldGeneration)
+        return;
+    CDE_TRACE_SCOPE("Build render data");
+
+    // The meshes of the previous world stay referenced until the new spheres took theirs, so a reset doesn't build
+    // the same meshes again
+    std::vector<SphereRenderData> previousRenderData;
+    previousRenderData.swap(renderTable.entries);
+    renderTable.clear();
+
+    const ScenarioSettings settings = world.scenarioSettings();
+    const Scenario& generator = scenarioAt(world.getScenario());
+    renderTable.resize(settings.numSpheres);
+    for (int i = 0; i < settings.numSpheres; i++) {
+        // Initial state of the sphere, the render data is drawn after it from the same stream
+        CounterRng rng(settings.seed, static_cast<uint64_t>(i));
+        ScenarioSphere sphere = generator.generate(settings, i, rng);
+
+        // Generate random complexity for lathing
+        int complexity = rng.randomInt(minComplexity, maxComplexity);
+
+        // Generate color based on radius, mass, and velocity
+        glm::vec3 color;
+        float red = std::min(1.0f, sphere.radius / settings.maxRadius);   // Higher radius, more red
+        float blue = std::min(1.0f, sphere.mass / settings.maxMass);      // Higher mass, more blue
+        float velocityMagnitude = glm::length(sphere.velocity);
+        float yellow = std::min(1.0f, velocityMagnitude / settings.maxVelocity); // Higher velocity, more yellow
+        color.r = red;
+        color.g = yellow;
+        color.b = blue;
+
+        renderTable.addSphere(i, complexity, color);
+    }
+
+    buildBoundary(settings.worldSize);
+    worldGeneration = world.generation;
+}
+
+void WorldRenderData::clear() {
+    renderTable.clear();
+    cubicWorldVertices.clear();
+    indices.clear();
+    worldGeneration = 0;
+}
+
+void WorldRenderData::buildBoundary(float worldSize) {
+    // Initialize the world boundary as a cube with vertices at the corners of the cube
+    const glm::vec3 corners[8] = {
+        glm::vec3(-worldSize, -worldSize, -worldSize), // Bottom-left-back
+        glm::vec3(worldSize, -worldSize, -worldSize),  // Bottom-right-back
+        glm::vec3(worldSize, worldSize, -worldSize),   // Top-right-back
+        glm::vec3(-worldSize, worldSize, -worldSize),  // Top-left-back
+        glm::vec3(-worldSize, -worldSize, worldSize),  // Bottom-left-front
+        glm::vec3(worldSize, -worldSize, worldSize),   // Bottom-right-front
+        glm::vec3(worldSize, worldSize, worldSize),    // Top-right-front
+        glm::vec3(-worldSize, worldSize, worldSize)    // Top-left-front
+    };
+
+    //Unify the cube vertices to the same color
+    glm::vec3 color(1.0f, 1.0f, 1.0f); // White color
+    cubicWorldVertices.clear();
+    for (const glm::vec3& corner : corners) {
+        vertice v;
+        v.pos = corner;
+        v.color = color;
+        cubicWorldVertices.push_back(v); // Add vertex to the mesh
+    }
+
+    // Use explicit edge indices for a wireframe cube
+    indices = {
+        0,1, 1,2, 2,3, 3,0,   // back face
+        4,5, 5,6, 6,7, 7,4,   // front face
+        0,4, 1,5, 2,6, 3,7    // connecting edges
+    };
+    boundaryGeneration = nextResourceGeneration();
+}
+
+// Derive the render data of the current frame from the physics state
+// Only called when a frame is actually drawn, and only spheres inside the view frustum get an instance
+void WorldRenderData::buildRenderInstances(SimulatorWorld& world, const glm::mat4& viewProjection, float alpha) {
+    CDE_TRACE_SCOPE("Build render instances");
+    const SphereStore& spheres = world.spheres;
+    Frustum frustum = Frustum::fromMatrix(viewProjection);
+    bool interpolate = alpha < 1.0f && static_cast<int>(world.previousCenterX.size()) == spheres.size();
+
+    // Spheres that may be in view: the broad phase's spatial index narrows them down to a range of one of its
+    // sorted axes when there is one, otherwise every sphere is tested
+    int count = spheres.size();
+    const int* candidates = nullptr;
+    const SpatialIndex& index = world.collisionDetection.spatialIndex();
+    if (index.valid && index.size() == count) {
+        glm::vec3 low, high;
+        frustum.bounds(low, high);
+        int first, last;
+        int axis = index.query(low, high, first, last);
+        candidates = index.axes[axis].index.data() + first;
+        count = last - first;
+    }
+    frustumTests = count;
+
+    // Every chunk writes its visible spheres to the front of its own range, then the chunks are packed
+    int numChunks = (count + instanceGrainSize - 1) / instanceGrainSize;
+    renderTable.instances.resize(count);
+    renderTable.instanceIds.resize(count);
+    instanceChunkCounts.resize(numChunks);
+    world.jobSystem.parallelFor(0, count, instanceGrainSize, [&](int begin, int end, int) {
+        int visible = begin;
+        for (int k = begin; k < end; k++) {
+            int i = candidates ? candidates[k] : k;
+            glm::vec3 center(spheres.centerX[i], spheres.centerY[i], spheres.centerZ[i]);
+            if (interpolate) {
+                glm::vec3 previous(world.previousCenterX[i], world.previousCenterY[i], world.previousCenterZ[i]);
+                center = previous + (center - previous) * alpha;
+            }
+            if (!frustum.intersectsSphere(center.x, center.y, center.z, spheres.radius[i]))
+                continue;
+
+            SphereInstance& instance = renderTable.instances[visible];
+            instance.center = center;
+            instance.radius = spheres.radius[i];
+            renderTable.instanceIds[visible] = spheres.id[i];
+            visible++;
+        }
+        instanceChunkCounts[begin / instanceGrainSize] = visible - begin;
+    });
+
+    int packed = 0;
+    for (int chunk = 0; chunk < numChunks; chunk++) {
+        int begin = chunk * instanceGrainSize;
+        int visible = instanceChunkCounts[chunk];
+        if (packed != begin) {
+            std::copy(renderTable.instances.begin() + begin, renderTable.instances.begin() + begin + visible, renderTable.instances.begin() + packed);
+            std::copy(renderTable.instanceIds.begin() + begin, renderTable.instanceIds.begin() + begin + visible, renderTable.instanceIds.begin() + packed);
+        }
+        packed += visible;
+    }
+    renderTable.instances.resize(packed);
+    renderTable.instanceIds.resize(packed);
+}
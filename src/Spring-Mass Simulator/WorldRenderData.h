@@ -0,0 +1,46 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "SimulatorWorld.h"
+#include "SphereMesh.h"
+#include "SphereRenderTable.h"
+
+//Render side of a SimulatorWorld, owned by the app next to the world it draws.
+//The world only simulates, it knows nothing of meshes, colors or its wireframe. The render data of its spheres is
+//derived from the scenario the world was generated from: replaying the scenario with the same seed gives every
+//sphere its initial state again, and the complexity is drawn after it from the same stream, so the same seed gives
+//the same colors and meshes. It is rebuilt whenever the world's generation changes, for a new world or a reset.
+
+class WorldRenderData
+{
+public:
+    WorldRenderData() : worldGeneration(0), boundaryGeneration(0), frustumTests(0) {}
+
+    // Build the render data of world unless it was built for the same generation already, every sphere gets a
+    // complexity in [minComplexity, maxComplexity]. Only reads what the world doesn't change while stepping, so the
+    // world may be stepped by another thread meanwhile.
+    void update(const SimulatorWorld& world, int minComplexity, int maxComplexity);
+
+    // Drop the data, a mesh is freed once no table uses it anymore
+    void clear();
+
+    // Gather the instance data of the visible spheres of world for the current frame, alpha interpolates from the
+    // previous state. Runs on the world's job system, so only for a world stepped by the calling thread.
+    void buildRenderInstances(SimulatorWorld& world, const glm::mat4& viewProjection, float alpha = 1.0f);
+
+    SphereRenderTable renderTable; // Render-only data of the spheres, indexed by sphere id, and the visible instances
+    // Bounding box of the simulation world
+    std::vector<vertice> cubicWorldVertices;
+    std::vector<int> indices;
+    uint64_t worldGeneration;    // Generation of the world the data was built for, 0 when empty
+    uint64_t boundaryGeneration; // Stamp of cubicWorldVertices and indices (see ResourceGeneration.h)
+    int frustumTests; // Spheres the last buildRenderInstances tested against the frustum, the others were culled by the spatial index
+
+private:
+    static constexpr int instanceGrainSize = 4096; // Spheres per chunk of buildRenderInstances
+
+    std::vector<int> instanceChunkCounts; // Visible spheres found by each chunk of buildRenderInstances
+
+    void buildBoundary(float worldSize);
+};
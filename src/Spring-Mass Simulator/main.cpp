@@ -6,17 +6,39 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/glm.hpp>
 #include <vector>
+#include <deque>
 #include <iostream>
 #include <cmath>
 #include "SimulatorWorld.h"
-#include "SphereMesh.h"
-#include "Utils.h"
+#include "SphereMeshCache.h"
+#include "WorldRenderData.h"
 #include "CollisionDetection.h"
 #include "SphereBV.h"
+#include "SimdKernels.h"
+#include "JobSystem.h"
+#include "SimulationThread.h"
+#include "WorldBuilder.h"
+#include "Frustum.h"
+#include "FixedStepClock.h"
+#include "CounterRng.h"
+#include "Scenario.h"
+#include "GpuResourceManager.h"
+#include "SphereRenderer.h"
+#include "Tracer.h"
+#include <chrono>
+#include <thread>
 
 // Global variables
 SimulatorWorld* worldSimulator = nullptr;
-GLuint shaderProgram; // Add missing declaration
+SimulationThread* simulationThread = nullptr; // Set while the simulation runs on its own thread, worldSimulator is null then
+std::deque<SimulationCommand> pendingCommands; // Commands the simulation thread's queue had no room for yet, sent again every frame
+const WorldSnapshot* snapshot = nullptr;      // Latest state published by simulationThread, taken once per frame
+WorldBuilder worldBuilder;                    // Builds the next worldSimulator in the background, the current one keeps running meanwhile
+bool dropBuiltWorld = false;                  // Stop was pressed while worldBuilder was busy
+GpuResourceManager* gpuResources = nullptr; // GL buffers and programs, lives as long as the GL context
+GpuProgram* shaderProgram = nullptr;        // Draws the world boundary
+SphereRenderer* sphereRenderer = nullptr;   // Instanced sphere draws
+WorldRenderData worldRender;                // Render data of the world drawn, built again for every new world or reset
 float deltaTime = 0.016f; // Add missing declaration for timing
 GLFWwindow* window; // Make window global
 
@@ -31,6 +53,17 @@ float minMass = 0.5f;
 float maxMass = 10.0f;      
 float worldSize = 20.0f;    
 float step = 0.016f;       
+int seed = 1;               // Random seed of the scene, the same seed builds the same scene
+int scenario = 0;           // Generator of the scene, index in the scenario table of Scenario.h
+int maxStepsPerFrame = 8;   // Cap of the steps a frame runs to catch up with the wall clock
+bool maxThroughput = false; // Run steps back to back for a whole frame budget instead of following the wall clock
+const double throughputFrameBudget = 1.0 / 60.0; // Seconds of stepping per frame with maxThroughput
+FixedStepClock stepClock(step, maxStepsPerFrame);
+int stepsThisFrame = 0;
+int visibleSpheres = 0;     // Spheres of the last frame inside the view frustum
+int culledSpheres = 0;      // The others, most of them never tested when the spatial index narrowed the candidates
+int frustumTests = 0;       // Spheres tested against the frustum planes
+const char* const tracePath = "simulation_trace.json"; // Chrome trace written by F9, see Tracer.h
 
 // Camera towards the world center origin
 glm::vec3 cameraPos(0.0f, 1.0f, 70.0f);
@@ -50,11 +83,10 @@ void init_shaders(){
         layout(location = 0) in vec3 aPos;
         layout(location = 1) in vec3 aColor;
         out vec3 ourColor;
-        uniform mat4 model;
         uniform mat4 view;
         uniform mat4 projection;
         void main() {
-            gl_Position = projection * view * model * vec4(aPos, 1.0);
+            gl_Position = projection * view * vec4(aPos, 1.0);
             ourColor = aColor;
         }
     )";
@@ -69,20 +101,8 @@ void init_shaders(){
         }
     )";
 
-    // Compile and link shaders (omitted for brevity)
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, nullptr);
-    glCompileShader(vertexShader);
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, nullptr);
-    glCompileShader(fragmentShader);
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-    glUseProgram(shaderProgram);
+    // Compile and link shaders
+    shaderProgram = &gpuResources->createProgram(vertexShaderSource, fragmentShaderSource);
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
@@ -152,121 +172,207 @@ void processInput(GLFWwindow* window) {
     else {
         EscKeyPressed = false;
     }
+
+#if CDE_ENABLE_TRACE
+    // F8 starts or stops recording the timeline of the threads, F9 writes the recorded events as a Chrome trace
+    static bool F8KeyPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_F8) == GLFW_PRESS) {
+        if (!F8KeyPressed)
+            Tracer::setRecording(!Tracer::isRecording());
+        F8KeyPressed = true;
+    }
+    else {
+        F8KeyPressed = false;
+    }
+    static bool F9KeyPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS) {
+        if (!F9KeyPressed) {
+            if (Tracer::writeChromeTrace(tracePath))
+                std::cout << "Trace written to " << tracePath << std::endl;
+            else
+                std::cerr << "Could not write the trace to " << tracePath << std::endl;
+        }
+        F9KeyPressed = true;
+    }
+    else {
+        F9KeyPressed = false;
+    }
+#endif
+}
+
+// Keep the render data in step with the world drawn, dropped when there is none so its meshes are freed
+void updateRenderData(const SimulatorWorld* world) {
+    if (world)
+        worldRender.update(*world, minComplexity, maxComplexity);
+    else if (worldRender.worldGeneration != 0)
+        worldRender.clear();
 }
 
 //Render world boundary (wireframe cube)
-void renderWorld(){
+void renderWorld(const SimulatorWorld* worldSimulator){
     if (!worldSimulator) return;
 
-    GLuint VBO, VAO, EBO; // Fix type from Guint to GLuint
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, worldSimulator->cubicWorldVertices.size() * sizeof(vertice), &worldSimulator->cubicWorldVertices[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, worldSimulator->indices.size() * sizeof(int), &worldSimulator->indices[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertice), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vertice), (void*)offsetof(vertice, color));
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind VBO
-    glBindVertexArray(0); // Unbind VAO
-
-    // Set the shader program and uniforms
-    glUseProgram(shaderProgram);
-    glm::mat4 model = glm::mat4(1.0f);
-    glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-    glm::mat4 projection = glm::perspective(glm::radians(fov), (float)800 / (float)600, 0.1f, 100.0f);
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    // Buffers uploaded once per world, they are only filled again for another world or a reset
+    const GpuMesh& boundary = gpuResources->worldBoundary(worldRender);
+    gpuResources->useProgram(*shaderProgram);
     // Render the world boundary
-    glBindVertexArray(VAO); //Use previous VAO configeruation
+    glBindVertexArray(boundary.vao);
     glLineWidth(2.0f); 
-    glDrawElements(GL_LINES, worldSimulator->indices.size(), GL_UNSIGNED_INT, 0); // Draw the cube as wireframe
+    glDrawElements(GL_LINES, boundary.indexCount, GL_UNSIGNED_INT, 0); // Draw the cube as wireframe
     glBindVertexArray(0); // Unbind VAO
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
     glUseProgram(0); // Unbind shader program
-    glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind VBO
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); // Unbind EBO
-    glBindVertexArray(0); // Unbind VAO
-    
 }
 
-// Render the spheres with their mesh using OpenGL non-traditional pipeline (triangle)
-void renderSpheres() {
+// Start the sphere draws of this frame for world, levels of detail are picked from the camera and the window height
+void beginSphereFrame(const SimulatorWorld& world) {
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    sphereRenderer->begin(cameraPos, glm::radians(fov), height, world.generation);
+}
+
+// Render the spheres of the world stepped by the render loop, alpha interpolates between its last two steps
+void renderSpheres(float alpha) {
     if (!worldSimulator) return;
-    
-    for (int i = 0; i < worldSimulator->numSpheres; i++) {
-        // Check if the mesh has vertices and indices before rendering
-        const auto& verts = worldSimulator->spheres[i].mesh->getVertices();
-        const auto& inds = worldSimulator->spheres[i].mesh->getIndices();
-        if(verts.empty() || inds.empty())
-            continue; // Skip rendering if mesh data is missing
-
-        //Unique VAO, VBO, EBO for each sphere
-        GLuint VBO, VAO, EBO;
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(vertice), &verts[0], GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, inds.size() * sizeof(int), &inds[0], GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertice), (void*)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vertice), (void*)offsetof(vertice, color));
-        glEnableVertexAttribArray(1);
-        glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind VBO
-        glBindVertexArray(0); // Unbind VAO
-
-        // Set the shader program and uniforms
-        glUseProgram(shaderProgram);
-        glm::mat4 model = worldSimulator->spheres[i].transform; // Use the sphere's transform matrix
-        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        glm::mat4 projection = glm::perspective(glm::radians(fov), (float)800 / (float)600, 0.1f, 100.0f);
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-        
-        // First render the solid sphere
-        glBindVertexArray(VAO);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL); // Ensure we're in fill mode for solid rendering
-        glDrawElements(GL_TRIANGLES, inds.size(), GL_UNSIGNED_INT, 0);
-        
-        // Now render the wireframe overlay
-        // Enable polygon offset to prevent z-fighting between solid and wireframe
-        glEnable(GL_POLYGON_OFFSET_FILL);
-        glPolygonOffset(1.0, 1.0);
-        
-        // Set wireframe mode and render
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        glLineWidth(1.0f); // Set the line width for the wireframe
-        
-        // Optional: Use a different color for wireframe by setting a uniform
-        // You'll need to add this uniform to your shader if you want to use it
-        // glUniform3f(glGetUniformLocation(shaderProgram, "wireframeColor"), 0.0f, 0.0f, 0.0f); // Black wireframe
-        
-        // Draw the wireframe
-        glDrawElements(GL_TRIANGLES, inds.size(), GL_UNSIGNED_INT, 0);
-        
-        // Reset polygon mode and disable polygon offset
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDisable(GL_POLYGON_OFFSET_FILL);
-        
-        glBindVertexArray(0); // Unbind VAO
-        glDeleteVertexArrays(1, &VAO);
-        glDeleteBuffers(1, &VBO);
-        glDeleteBuffers(1, &EBO);
-        glUseProgram(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    // Derive the instance data of the visible spheres for this frame
+    worldRender.buildRenderInstances(*worldSimulator, gpuResources->frame().viewProjection, alpha);
+    const SphereRenderTable& renderTable = worldRender.renderTable;
+
+    beginSphereFrame(*worldSimulator);
+    for (size_t i = 0; i < renderTable.instances.size(); i++) {
+        int id = renderTable.instanceIds[i];
+        sphereRenderer->add(id, renderTable.instances[i], renderTable[id]);
+    }
+    sphereRenderer->draw();
+    visibleSpheres = static_cast<int>(renderTable.instances.size());
+    culledSpheres = worldSimulator->spheres.size() - visibleSpheres;
+    frustumTests = worldRender.frustumTests;
+}
+
+// Render the spheres of the latest snapshot of the simulation thread, culled here since the snapshot holds every sphere
+void renderSpheres(const WorldSnapshot& snapshot) {
+    if (!snapshot.world) return;
+
+    Frustum frustum = Frustum::fromMatrix(gpuResources->frame().viewProjection);
+    const SphereRenderTable& renderTable = worldRender.renderTable;
+    float alpha = snapshot.interpolationAlpha(std::chrono::steady_clock::now());
+
+    // Only the spheres of the index range around the frustum are tested, or all of them without an index
+    int count = static_cast<int>(snapshot.spheres.size());
+    const int* candidates = nullptr;
+    if (snapshot.index.valid && snapshot.index.size() == count) {
+        glm::vec3 low, high;
+        frustum.bounds(low, high);
+        int first, last;
+        int axis = snapshot.index.query(low, high, first, last);
+        candidates = snapshot.index.axes[axis].index.data() + first;
+        count = last - first;
+    }
+
+    beginSphereFrame(*snapshot.world);
+    visibleSpheres = 0;
+    for (int k = 0; k < count; k++) {
+        int i = candidates ? candidates[k] : k;
+        SphereInstance instance = { snapshot.spheres[i].center, snapshot.spheres[i].radius };
+        const glm::vec3& previous = snapshot.previousCenters[i];
+        instance.center = previous + (instance.center - previous) * alpha;
+        if (!frustum.intersectsSphere(instance.center.x, instance.center.y, instance.center.z, instance.radius))
+            continue;
+        sphereRenderer->add(snapshot.ids[i], instance, renderTable[snapshot.ids[i]]);
+        visibleSpheres++;
+    }
+    sphereRenderer->draw();
+    culledSpheres = static_cast<int>(snapshot.spheres.size()) - visibleSpheres;
+    frustumTests = count;
+}
+
+// Step the world of the render loop for one frame, returns the interpolation alpha to draw it with
+float stepFrame(float frameSeconds) {
+    if (maxThroughput) {
+        // Step until the frame budget is spent, the latest state is drawn as is
+        stepsThisFrame = 0;
+        auto start = std::chrono::steady_clock::now();
+        do {
+            worldSimulator->stepSimulation(step);
+            stepsThisFrame++;
+        } while (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < throughputFrameBudget);
+        // The last step isn't known before the budget is spent: keep the state drawn now instead, so frames
+        // without steps after switching back to the wall clock interpolate from it rather than from a stale state
+        worldSimulator->savePreviousState();
+        return 1.0f;
+    }
+
+    stepsThisFrame = stepClock.advance(frameSeconds);
+    for (int i = 0; i < stepsThisFrame; i++) {
+        if (i == stepsThisFrame - 1)
+            worldSimulator->savePreviousState();
+        worldSimulator->stepSimulation(step);
+    }
+    return stepClock.interpolationAlpha();
+}
+
+
+// Settings of the world the UI asks for, for the simulation thread
+WorldSettings currentWorldSettings(int method, int threadCount, bool pinThreads) {
+    WorldSettings settings = {};
+    settings.numSpheres = numSpheres;
+    settings.minRadius = minRadius;
+    settings.maxRadius = maxRadius;
+    settings.minVelocity = minVelocity;
+    settings.maxVelocity = maxVelocity;
+    settings.minMass = minMass;
+    settings.maxMass = maxMass;
+    settings.worldSize = worldSize;
+    settings.seed = static_cast<uint32_t>(seed);
+    settings.method = method;
+    settings.numThreads = threadCount;
+    settings.pinThreads = pinThreads;
+    settings.headless = false;
+    settings.scenario = scenario;
+    return settings;
+}
+
+// Settings only matter by their latest value, Start, Stop, Reset and ResetWorkerStats must all arrive
+bool isSettingCommand(SimulationCommand::Type type) {
+    return type == SimulationCommand::Type::SetStepTime || type == SimulationCommand::Type::SetPacing ||
+        type == SimulationCommand::Type::SetMethod || type == SimulationCommand::Type::SetThreads;
+}
+
+// Pass the pending commands to the simulation thread, in order, as far as its queue has room
+void flushCommands() {
+    while (simulationThread && !pendingCommands.empty() && simulationThread->send(pendingCommands.front()))
+        pendingCommands.pop_front();
+}
+
+// Queue a command for the simulation thread
+// When its queue is full (a slow step while a slider is dragged) the command waits in pendingCommands for the next
+// frame instead of being dropped. A setting still waiting there is replaced by its new value, unless a Start, Stop
+// or Reset was queued after it: the setting must still apply before that command.
+void sendCommand(SimulationCommand command) {
+    if (isSettingCommand(command.type)) {
+        for (auto pending = pendingCommands.rbegin(); pending != pendingCommands.rend() && isSettingCommand(pending->type); ++pending) {
+            if (pending->type == command.type) {
+                *pending = command;
+                return;
+            }
+        }
     }
+    pendingCommands.push_back(command);
+    flushCommands();
+}
+
+SimulationCommand makeCommand(SimulationCommand::Type type) {
+    SimulationCommand command = {};
+    command.type = type;
+    return command;
+}
+
+// Send the step pacing of the UI to the simulation thread
+void sendPacing() {
+    SimulationCommand command = makeCommand(SimulationCommand::Type::SetPacing);
+    command.maxStepsPerFrame = maxStepsPerFrame;
+    command.maxThroughput = maxThroughput;
+    sendCommand(command);
 }
 
 void drawImGuiControls(int& numSpheres, float& minRadius, float& maxRadius, float& minVelocity, float& maxVelocity, float& minMass, float& maxMass, float& worldSize, int minComplexity, int maxComplexity) {
@@ -287,40 +393,175 @@ void drawImGuiControls(int& numSpheres, float& minRadius, float& maxRadius, floa
     ImGui::SliderFloat("Min Mass", &minMass, 0.1f, 10.0f);                      // 范围0.1~5.0
     ImGui::SliderFloat("Max Mass", &maxMass, 0.1f, 10.0f);                      // 范围0.1~5.0
     ImGui::SliderFloat("World Size", &worldSize, 5.0f, 50.0f);                 // 范围5.0~50.0
+    ImGui::InputInt("Seed", &seed);
+    ImGui::SameLine();
+    if (ImGui::Button("Random Seed")) {
+        seed = static_cast<int>(CounterRng::clockSeed() & 0x7fffffff);
+    }
+    // Applied by the next Start, like the ranges above
+    ImGui::Combo("Scenario", &scenario, [](void*, int index) { return scenarioAt(index).name; }, nullptr, scenarioCount());
+    ImGui::TextWrapped("%s", scenarioAt(scenario).description);
     ImGui::Text("Simulation Method: ");
     const char* methods[] = { "Sweep and Prune", "Brute Force", "Grid" };
     static int method = 0;
-    ImGui::Combo("Method", &method, methods, IM_ARRAYSIZE(methods));
+    if (ImGui::Combo("Method", &method, methods, IM_ARRAYSIZE(methods))) {
+        if (simulationThread) {
+            SimulationCommand command = makeCommand(SimulationCommand::Type::SetMethod);
+            command.method = method;
+            sendCommand(command);
+        } else if (worldSimulator) {
+            worldSimulator->collisionDetection.setMethod(method);
+        }
+    }
+    // Vectorized kernels, picked from CPUID at startup, can be forced here to compare the paths
+    const char* simdPaths[] = { "Scalar", "SSE2", "AVX2", "AVX-512" };
+    int simdPath = static_cast<int>(simdKernels().path);
+    if (ImGui::Combo("SIMD Path", &simdPath, simdPaths, IM_ARRAYSIZE(simdPaths))) {
+        if (!selectSimdPath(static_cast<SimdPath>(simdPath)))
+            std::cout << simdPaths[simdPath] << " is not supported by this CPU" << std::endl;
+    }
+    ImGui::Text("Best SIMD path of this CPU: %s", simdPathName(bestSimdPath()));
     ImGui::Text("Simulation Step: ");
-    ImGui::SliderFloat("Step Time", &step, 0.001f, 0.05f);                    // 范围0.001~0.05
+    if (ImGui::SliderFloat("Step Time", &step, 0.001f, 0.05f)) { // 范围0.001~0.05
+        stepClock.setStepTime(step);
+        if (simulationThread) {
+            SimulationCommand command = makeCommand(SimulationCommand::Type::SetStepTime);
+            command.stepTime = step;
+            sendCommand(command);
+        }
+    }
+    // Steps follow the wall clock, a frame runs as many as the time since the last one asks for up to this cap
+    bool pacingChanged = ImGui::SliderInt("Max Steps Per Frame", &maxStepsPerFrame, 1, 32);
+    pacingChanged |= ImGui::Checkbox("Max Throughput", &maxThroughput);
+    if (pacingChanged) {
+        stepClock.setMaxStepsPerFrame(maxStepsPerFrame);
+        if (simulationThread)
+            sendPacing();
+    }
+    // Job system, 0 threads uses every hardware thread
+    static int threadCount = 0;
+    static bool pinThreads = false;
+    ImGui::SliderInt("Worker Threads", &threadCount, 0, static_cast<int>(std::thread::hardware_concurrency()));
+    ImGui::Checkbox("Pin Threads", &pinThreads);
+    if (ImGui::Button("Apply Threads")) {
+        if (simulationThread) {
+            SimulationCommand command = makeCommand(SimulationCommand::Type::SetThreads);
+            command.numThreads = threadCount;
+            command.pinThreads = pinThreads;
+            sendCommand(command);
+        } else if (worldSimulator) {
+            worldSimulator->setThreadCount(threadCount, pinThreads);
+        }
+    }
     ImGui::Text("Simulation Control: ");
-    if (ImGui::Button("Start Simulation")) {
-        // Initialize the simulator world with new parameters
-        delete worldSimulator; // Clean up the previous simulator
-        worldSimulator = new SimulatorWorld(minComplexity, maxComplexity, numSpheres,
-            minRadius, maxRadius, minVelocity, maxVelocity, minMass, maxMass, worldSize);           
-        worldSimulator->initializeWorld(); // Reinitialize the world with new spheres
-        worldSimulator->stepSimulation(step);
+    // Step the simulation on its own thread instead of once per frame, applied by the next Start
+    static bool simulationOnOwnThread = false;
+    ImGui::Checkbox("Simulation Thread", &simulationOnOwnThread);
+    // A world being built by worldBuilder can't be replaced, wait for it
+    ImGui::BeginDisabled(worldBuilder.busy());
+    bool startPressed = ImGui::Button("Start Simulation");
+    ImGui::EndDisabled();
+    if (startPressed) {
+        if (simulationOnOwnThread) {
+            // Clean up the previous simulator of the render loop
+            delete worldSimulator;
+            worldSimulator = nullptr;
+            if (!simulationThread) {
+                simulationThread = new SimulationThread();
+                snapshot = nullptr;
+            }
+            SimulationCommand stepCommand = makeCommand(SimulationCommand::Type::SetStepTime);
+            stepCommand.stepTime = step;
+            sendCommand(stepCommand);
+            sendPacing();
+            SimulationCommand startCommand = makeCommand(SimulationCommand::Type::Start);
+            startCommand.settings = currentWorldSettings(method, threadCount, pinThreads);
+            sendCommand(startCommand);
+        } else {
+            delete simulationThread;
+            simulationThread = nullptr;
+            pendingCommands.clear();
+            snapshot = nullptr;
+
+            // Initialize the simulator world with new parameters in the background, swapped in once ready
+            worldBuilder.start(currentWorldSettings(method, threadCount, pinThreads));
+            dropBuiltWorld = false;
+        }
+    }
+    float buildProgress = worldBuilder.busy() ? worldBuilder.progress() : (simulationThread ? simulationThread->buildProgress() : -1.0f);
+    if (buildProgress >= 0.0f) {
+        ImGui::ProgressBar(buildProgress, ImVec2(-FLT_MIN, 0), "Building world...");
     }
     if (ImGui::Button("Stop Simulation")) {
         // Stop the simulation and clean up resources
-        if (worldSimulator) {
-            worldSimulator->stopSimulation();
-            delete worldSimulator;
-            worldSimulator = nullptr;
+        if (simulationThread) {
+            sendCommand(makeCommand(SimulationCommand::Type::Stop));
+        } else {
+            if (worldSimulator) {
+                worldSimulator->stopSimulation();
+                delete worldSimulator;
+                worldSimulator = nullptr;
+            }
+            dropBuiltWorld = worldBuilder.busy();
         }
     }
     if (ImGui::Button("Reset Simulation")) {
-        worldSimulator->resetSimulation();
+        if (simulationThread)
+            sendCommand(makeCommand(SimulationCommand::Type::Reset));
+        else if (worldSimulator)
+            worldSimulator->resetSimulation();
     }
     if (ImGui::Button("Exit")) {
         glfwSetWindowShouldClose(window, true);
     }
     ImGui::Text("FPS: %.1f", ImGui::GetIO().Framerate);
+    if (worldSimulator || (snapshot && snapshot->world)) {
+        // With the simulation thread, every figure comes from the snapshot instead of the running world
+        if (snapshot)
+            ImGui::Text("Simulation step %llu: %.2f ms", static_cast<unsigned long long>(snapshot->step), snapshot->stepMilliseconds);
+        else
+            ImGui::Text("Steps this frame: %d", stepsThisFrame);
+        ImGui::Text("Steps dropped to keep up: %lld", snapshot ? snapshot->droppedSteps : stepClock.droppedSteps());
+#if CDE_ENABLE_STATS
+        // Average of the last steps, per phase
+        StepStats phaseStats = snapshot ? snapshot->phaseStats : worldSimulator->stats.average();
+        ImGui::Text("Broad %.2f ms, narrow %.2f ms, response %.2f ms, integration %.2f ms", StepStats::toMs(phaseStats.broadNs),
+            StepStats::toMs(phaseStats.narrowNs), StepStats::toMs(phaseStats.responseNs), StepStats::toMs(phaseStats.integrationNs));
+        ImGui::Text("Pairs: %.0f candidates, %.0f colliding, %.0f GJK iterations", phaseStats.candidatePairs,
+            phaseStats.confirmedPairs, phaseStats.gjkIterations);
+        ImGui::Text("Wall bounces per step: %.1f", phaseStats.wallBounces);
+#endif
+        size_t arenaHighWaterMark = snapshot ? snapshot->arenaHighWaterMark : worldSimulator->frameArenas.totalHighWaterMark();
+        ImGui::Text("Frame arena high-water: %.1f KB", arenaHighWaterMark / 1024.0);
+        SphereMeshCache::Usage meshUsage = SphereMeshCache::get().usage();
+        ImGui::Text("Shared sphere meshes: %d (%.1f MB)", meshUsage.meshCount, meshUsage.memoryBytes / (1024.0 * 1024.0));
+        if (sphereRenderer)
+            ImGui::Text("Sphere draw calls: %d for %d spheres, %lld triangles", sphereRenderer->drawCalls(), sphereRenderer->instanceCount(), sphereRenderer->triangleCount());
+        ImGui::Text("Visible spheres: %d, culled: %d (%d tested against the frustum)", visibleSpheres, culledSpheres, frustumTests);
+        if (gpuResources)
+            ImGui::Text("GPU sphere meshes: %d, buffer uploads: %d", gpuResources->sphereMeshCount(), gpuResources->uploadCount());
+        // Share of the time each worker spent running jobs, the rest is idle (scaling losses)
+        std::vector<WorkerStats> workerStats = snapshot ? snapshot->workerStats : worldSimulator->jobSystem.stats();
+        for (size_t i = 0; i < workerStats.size(); i++) {
+            double total = workerStats[i].busySeconds + workerStats[i].idleSeconds;
+            ImGui::Text("Worker %d: %.1f%% busy, %llu jobs, %llu stolen", static_cast<int>(i),
+                total > 0.0 ? 100.0 * workerStats[i].busySeconds / total : 0.0,
+                static_cast<unsigned long long>(workerStats[i].jobsExecuted), static_cast<unsigned long long>(workerStats[i].jobsStolen));
+        }
+        if (ImGui::Button("Reset Worker Stats")) {
+            if (simulationThread)
+                sendCommand(makeCommand(SimulationCommand::Type::ResetWorkerStats));
+            else
+                worldSimulator->jobSystem.resetStats();
+        }
+    }
     ImGui::Text("Camera Position: (%.1f, %.1f, %.1f)", cameraPos.x, cameraPos.y, cameraPos.z);
     //Use Wasd keys to control camera view
     ImGui::Text("Use WASD to control camera view.");
     ImGui::Text("Press ESC to toggle cursor mode.");
+#if CDE_ENABLE_TRACE
+    ImGui::Text("Press F8 to %s recording a trace, F9 to save it to %s.", Tracer::isRecording() ? "stop" : "start", tracePath);
+#endif
     ImGui::End();
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
@@ -348,15 +589,18 @@ int main() {
     ImGui_ImplOpenGL3_Init("#version 330");
 
     // Initialize Spring System from global variable input
-    worldSimulator = new SimulatorWorld(minComplexity, maxComplexity, numSpheres,
-        minRadius, maxRadius, minVelocity, maxVelocity, minMass, maxMass, worldSize);
+    worldSimulator = new SimulatorWorld(numSpheres, minRadius, maxRadius, minVelocity, maxVelocity, minMass, maxMass, worldSize, static_cast<uint32_t>(seed));
 
     //Init shaders
+    gpuResources = new GpuResourceManager();
     init_shaders();
+    sphereRenderer = new SphereRenderer(*gpuResources);
 
     float lastFrameTime = 0.0f;
 
+    CDE_TRACE_THREAD_NAME("Main");
     while (!glfwWindowShouldClose(window)) {
+        CDE_TRACE_SCOPE("Frame");
         float currentFrameTime = (float)glfwGetTime();
         deltaTime = currentFrameTime - lastFrameTime;
         lastFrameTime = currentFrameTime;
@@ -368,28 +612,55 @@ int main() {
         // glCullFace(GL_BACK); 
         // glFrontFace(GL_CCW); // Set counter-clockwise as the default winding order
 
+        // Swap in the world built in the background once it is ready
+        if (std::unique_ptr<SimulatorWorld> built = worldBuilder.take()) {
+            if (!dropBuiltWorld) {
+                delete worldSimulator;
+                worldSimulator = built.release();
+                stepClock.reset();
+            }
+            dropBuiltWorld = false;
+        }
+
+        // Commands left over by a full queue, then the latest state of the simulation thread, it keeps stepping
+        // while this frame is drawn
+        flushCommands();
+        if (simulationThread)
+            snapshot = &simulationThread->latestSnapshot();
+
         //UI controls
         drawImGuiControls(numSpheres, minRadius, maxRadius, minVelocity, maxVelocity, minMass, maxMass, worldSize, minComplexity, maxComplexity);
 
         // Process input
         processInput(window);
+        // Camera of this frame, shared by everything drawn in it
+        gpuResources->beginFrame(glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp),
+            glm::perspective(glm::radians(fov), (float)800 / (float)600, 0.1f, 100.0f));
         // Draw ImGui controls
-        // Render the world boundary
-        renderWorld();
-        // Render the spheres
-        renderSpheres();
-
-        // Step the simulation
-        worldSimulator->stepSimulation(step);
+        updateRenderData(simulationThread ? (snapshot ? snapshot->world.get() : nullptr) : worldSimulator);
+        if (simulationThread && snapshot) {
+            renderWorld(snapshot->world.get());
+            renderSpheres(*snapshot);
+        } else if (worldSimulator) {
+            // Step the simulation as far as the wall clock went since the last frame
+            float alpha = stepFrame(deltaTime);
+            // Render the world boundary
+            renderWorld(worldSimulator);
+            // Render the spheres
+            renderSpheres(alpha);
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
     // clean up
+    delete simulationThread;
     if (worldSimulator) {
         delete worldSimulator;
     }
+    delete sphereRenderer;
+    delete gpuResources;
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();